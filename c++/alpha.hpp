@@ -0,0 +1,140 @@
+#ifndef ALPHA_HPP
+#define ALPHA_HPP
+
+/**
+ * Contains the compact representation of an object's allowable usage contexts.
+ */
+
+#include <assert.h>
+#include <cstdint>
+#include <initializer_list>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace FilterModel {
+
+/**
+ * A fixed width bitmask with bit i set when category i is allowed, plus the number of categories.
+ *
+ * Alphas are copied into every sample and used as map keys on the likelyhood path, so they are
+ * kept to a single machine word rather than a heap allocated std::vector<bool>. Indexing, size()
+ * and brace initialisation behave like the vector they replace.
+ */
+class Alpha {
+   public:
+    typedef uint32_t bits_t;
+    static const int MAX_SIZE = 32;
+
+    Alpha() : bits(0), n_categories(0) {}
+
+    Alpha(std::initializer_list<bool> categories) : bits(0), n_categories(0) {
+        for (bool category : categories) {
+            push_back(category);
+        }
+    }
+
+    explicit Alpha(const std::vector<bool> &categories) : bits(0), n_categories(0) {
+        for (bool category : categories) {
+            push_back(category);
+        }
+    }
+
+    /**
+     * Returns the alpha over size categories whose allowed categories are the set bits of bits.
+     */
+    static Alpha from_bits(bits_t bits, int size) {
+        assert(0 <= size && size <= MAX_SIZE);
+        Alpha alpha;
+        alpha.n_categories = size;
+        alpha.bits = bits & all_bits(size);
+        return alpha;
+    }
+
+    int size() const { return n_categories; }
+    bool empty() const { return n_categories == 0; }
+
+    bool operator[](int i) const { return (bits >> i) & 1u; }
+    bool at(int i) const {
+        assert(0 <= i && i < n_categories);
+        return (*this)[i];
+    }
+
+    void set(int i, bool value = true) {
+        assert(0 <= i && i < n_categories);
+        if (value) {
+            bits |= bits_t(1) << i;
+        } else {
+            bits &= ~(bits_t(1) << i);
+        }
+    }
+
+    void push_back(bool value) {
+        assert(n_categories < MAX_SIZE);
+        ++n_categories;
+        set(n_categories - 1, value);
+    }
+
+    bits_t mask() const { return bits; }
+
+    /**
+     * Returns the number of allowed categories, i.e. sum_i alpha_i.
+     */
+    int count() const { return __builtin_popcount(bits); }
+    bool none() const { return bits == 0; }
+
+    Alpha operator~() const { return from_bits(~bits, n_categories); }
+    Alpha operator&(const Alpha &other) const {
+        assert(n_categories == other.n_categories);
+        return from_bits(bits & other.bits, n_categories);
+    }
+
+    std::vector<bool> to_vector() const {
+        std::vector<bool> categories(n_categories);
+        for (int i = 0; i < n_categories; ++i) {
+            categories[i] = (*this)[i];
+        }
+        return categories;
+    }
+
+    bool operator==(const Alpha &other) const {
+        return bits == other.bits && n_categories == other.n_categories;
+    }
+    bool operator!=(const Alpha &other) const { return !(*this == other); }
+    bool operator<(const Alpha &other) const {
+        return n_categories < other.n_categories ||
+               (n_categories == other.n_categories && bits < other.bits);
+    }
+
+   private:
+    bits_t bits;
+    int n_categories;
+
+    static bits_t all_bits(int size) {
+        return size == MAX_SIZE ? ~bits_t(0) : (bits_t(1) << size) - 1;
+    }
+};
+
+/**
+ * Converts an alpha to a string with square brackets and commas seprators, e.g. [1,0,1], the same
+ * as vector_to_string does for a vector of bools.
+ */
+inline std::string vector_to_string(const Alpha &alpha) {
+    std::string out = "[";
+    for (int i = 0; i < alpha.size(); ++i) {
+        if (i > 0) {
+            out += ",";
+        }
+        out += alpha[i] ? "1" : "0";
+    }
+    out += "]";
+    return out;
+}
+
+inline std::ostream &operator<<(std::ostream &out, const Alpha &alpha) {
+    return out << vector_to_string(alpha);
+}
+
+}  // namespace FilterModel
+
+#endif
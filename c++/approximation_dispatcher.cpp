@@ -0,0 +1,165 @@
+#include "approximation_dispatcher.hpp"
+
+#include "gaussian_polytope.hpp"
+#include "model_distribution.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+namespace FilterModel {
+
+namespace {
+
+struct CalibrationProblem {
+    int n_positive;
+    int n_negative;
+    alpha_t alpha;
+    delta_t delta;
+    category_counts_t object_counts;
+};
+
+/**
+ * Returns the median over reps calls of the time f takes, in nanoseconds.
+ */
+template <class F>
+double median_ns(const F &f, int reps) {
+    std::vector<double> times;
+    for (int rep = 0; rep < reps; ++rep) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        auto end = std::chrono::steady_clock::now();
+        times.push_back(std::chrono::duration<double, std::nano>(end - start).count());
+    }
+    std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+    return times.at(times.size() / 2);
+}
+
+double median(std::vector<double> values) {
+    std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+    return values.at(values.size() / 2);
+}
+
+// Keeps the optimiser from dropping calls whose results are unused.
+volatile double sink;
+
+}  // namespace
+
+double NormalApproximation::sum() const { return std::exp(std::log(probability) + log_adjust); }
+
+ApproximationDispatcher::ApproximationDispatcher(double tolerance, const DispatchModel &model)
+    : tolerance(tolerance), model(model) {}
+
+DispatchModel ApproximationDispatcher::calibrate() {
+    DispatchModel model;
+
+    // Timings, on three category problems with n^- from 25 to 400.
+    std::vector<double> exact_ns_per_point;
+    std::vector<double> closed_form_ns;
+    for (int n : {25, 50, 100, 200, 400}) {
+        CalibrationProblem problem = {n, n, {1, 1, 1}, {0.2, 0.3, 0.5}, {n / 2, n / 2, n}};
+        double points = lattice_points(problem.n_positive, problem.alpha, problem.object_counts);
+        exact_ns_per_point.push_back(
+            median_ns(
+                [&problem]() {
+                    sink = ModelDistribution::calculate_log_sum_over_k_negative_incremental(
+                        problem.n_positive, problem.n_negative, problem.alpha, problem.delta,
+                        problem.object_counts);
+                },
+                5) /
+            points);
+        closed_form_ns.push_back(median_ns(
+            [&problem]() {
+                sink = ModelDistribution::calculate_normal_approximation(
+                           problem.n_negative, problem.alpha, problem.delta, problem.object_counts)
+                           .probability;
+            },
+            5));
+    }
+    model.exact_ns_per_point = median(exact_ns_per_point);
+    model.closed_form_ns = median(closed_form_ns);
+
+    CalibrationProblem four_categories = {
+        40, 40, {1, 1, 1, 1}, {0.1, 0.2, 0.3, 0.4}, {20, 20, 20, 20}};
+    model.mvi3_ns = median_ns(
+        [&four_categories]() {
+            sink = ModelDistribution::calculate_normal_approximation(
+                       four_categories.n_negative, four_categories.alpha, four_categories.delta,
+                       four_categories.object_counts)
+                       .probability;
+        },
+        3);
+
+    // Error constant, the largest |exact - approximate| sqrt(min n p) over a grid of problems.
+    double error_constant = 0;
+    std::vector<delta_t> deltas = {{1.0 / 3, 1.0 / 3, 1.0 / 3}, {0.1, 0.3, 0.6}, {0.05, 0.15, 0.8}};
+    for (const delta_t &delta : deltas) {
+        for (int n_negative : {20, 60, 180}) {
+            for (const category_counts_t &shape :
+                 std::vector<category_counts_t>({{1, 1, 1}, {1, 2, 4}, {4, 1, 1}})) {
+                category_counts_t object_counts;
+                for (int share : shape) {
+                    object_counts.push_back(share * n_negative * 3 / 5);
+                }
+                int n = std::accumulate(object_counts.begin(), object_counts.end(), 0);
+                if (n < n_negative) {
+                    continue;
+                }
+                NormalApproximation approximation =
+                    ModelDistribution::calculate_normal_approximation(n_negative, {1, 1, 1}, delta,
+                                                                      object_counts);
+                double exact =
+                    std::exp(ModelDistribution::calculate_log_sum_over_k_negative_incremental(
+                        n - n_negative, n_negative, {1, 1, 1}, delta, object_counts));
+                error_constant =
+                    std::max(error_constant, std::abs(exact - approximation.sum()) *
+                                                 std::sqrt(approximation.min_mean_count));
+            }
+        }
+    }
+    model.error_constant = 2 * error_constant;
+
+    return model;
+}
+
+double ApproximationDispatcher::lattice_points(int n_positive, const alpha_t &alpha,
+                                               const category_counts_t &object_counts) {
+    // The last allowed category is fixed by the others.
+    double points = 1;
+    int n_free = alpha.count() - 1;
+    for (int i = 0; i < alpha.size() && n_free > 0; ++i) {
+        if (alpha[i]) {
+            points *= std::min(object_counts.at(i), n_positive) + 1;
+            --n_free;
+        }
+    }
+    return points;
+}
+
+bool ApproximationDispatcher::approximation_is_cheaper(
+    int n_positive, const alpha_t &alpha, const category_counts_t &object_counts) const {
+    if (tolerance <= 0) {
+        return false;
+    }
+    double exact_ns = model.exact_ns_per_point * lattice_points(n_positive, alpha, object_counts);
+    double approximation_ns =
+        alpha.count() - 1 <= MAX_CLOSED_FORM_DIMENSIONS ? model.closed_form_ns : model.mvi3_ns;
+    return approximation_ns < exact_ns;
+}
+
+double ApproximationDispatcher::log_error_bound(const NormalApproximation &approximation) const {
+    if (approximation.dimensions == 0) {
+        // A single free category is evaluated exactly.
+        return 0;
+    }
+    if (!(approximation.probability > 0 && approximation.min_mean_count > 0)) {
+        return std::numeric_limits<double>::infinity();
+    }
+    return model.error_constant / std::sqrt(approximation.min_mean_count) /
+           approximation.probability;
+}
+
+}  // namespace FilterModel
@@ -0,0 +1,85 @@
+#ifndef APPROXIMATION_DISPATCHER_HPP
+#define APPROXIMATION_DISPATCHER_HPP
+
+/**
+ * Contains the cost and error model used to choose between the exact and normal approximation
+ * sums over k^-.
+ */
+
+#include "types.hpp"
+
+namespace FilterModel {
+
+/**
+ * The normal approximation to the sum over k^- before it is scaled back up, i.e. the sum is
+ * exp(log_adjust) * probability.
+ */
+struct NormalApproximation {
+    // The mass the approximating guassian puts on the valid k^-.
+    double probability;
+    // The log multinomial factor of the categories whose k^- is fixed.
+    double log_adjust;
+    // Dimension of the approximating guassian.
+    int dimensions;
+    // The smallest mean count n p_i among the categories the guassian approximates.
+    double min_mean_count;
+
+    double sum() const;
+};
+
+/**
+ * Picks the cheapest way to evaluate a sum over k^- whose estimated error is within a tolerance.
+ *
+ * Exact evaluation costs about one kernel step per k^- lattice point, O(n^2) points for three
+ * categories. The normal approximation costs about the same for any n: microseconds in closed
+ * form up to two dimensions, much more through MVI3 above that. Its absolute error on the
+ * probability is bounded by error_constant / sqrt(min_mean_count), a Berry-Esseen style bound, so
+ * the error it adds to the log likelyhood is about that bound divided by the probability itself.
+ * In the tails that is large and the exact sum is used even when it is slower.
+ */
+class ApproximationDispatcher {
+   public:
+    /**
+     * tolerance: The largest acceptable absolute error in log(sum over k^-), i.e. the relative
+     *   error of the sum. Zero or less never approximates.
+     */
+    explicit ApproximationDispatcher(double tolerance,
+                                     const DispatchModel &model = DispatchModel());
+
+    /**
+     * Times the exact and approximate kernels on a fixed set of problems and fits the error
+     * constant to the largest error seen, scaled by a safety factor. Takes a fraction of a second.
+     */
+    static DispatchModel calibrate();
+
+    /**
+     * Estimates the number of k^- lattice points exact evaluation visits, from the width of each
+     * allowed category's range ignoring the constraint on their sum.
+     */
+    static double lattice_points(int n_positive, const alpha_t &alpha,
+                                 const category_counts_t &object_counts);
+
+    /**
+     * Returns true if the approximation is expected to be faster than the exact sum.
+     */
+    bool approximation_is_cheaper(int n_positive, const alpha_t &alpha,
+                                  const category_counts_t &object_counts) const;
+
+    /**
+     * Returns the estimated error the approximation adds to log(sum over k^-).
+     */
+    double log_error_bound(const NormalApproximation &approximation) const;
+
+    bool within_tolerance(const NormalApproximation &approximation) const {
+        return log_error_bound(approximation) <= tolerance;
+    }
+
+    const DispatchModel &get_model() const { return model; }
+
+   private:
+    double tolerance;
+    DispatchModel model;
+};
+}  // namespace FilterModel
+
+#endif
@@ -0,0 +1,103 @@
+#include "comparison_report.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace FilterModel {
+
+ComparisonReport::ComparisonReport(double fraction) : fraction(fraction) {}
+
+bool ComparisonReport::should_sample() {
+    long call = calls++;
+    return std::floor((call + 1) * fraction) > std::floor(call * fraction);
+}
+
+int ComparisonReport::error_bin(double abs_log_error) {
+    if (!std::isfinite(abs_log_error)) {
+        return N_ERROR_BINS - 1;
+    }
+    if (abs_log_error < std::pow(10.0, MIN_ERROR_DECADE)) {
+        return 0;
+    }
+    int decade = std::floor(std::log10(abs_log_error));
+    return std::min(decade - MIN_ERROR_DECADE + 1, N_ERROR_BINS - 1);
+}
+
+void ComparisonReport::add(const ComparisonSample &sample) {
+    int n_negative_bucket = 0;
+    while (2 * n_negative_bucket + 1 <= sample.n_negative) {
+        n_negative_bucket = 2 * n_negative_bucket + 1;
+    }
+    std::string alpha;
+    for (int i = 0; i < sample.alpha.size(); ++i) {
+        alpha += sample.alpha[i] ? '1' : '0';
+    }
+    double abs_log_error = std::abs(sample.log_approximation - sample.log_exact);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    Bucket &bucket = buckets[key_t(n_negative_bucket, sample.dimensions, alpha)];
+    ++bucket.count;
+    bucket.sum_abs_log_error += abs_log_error;
+    bucket.max_abs_log_error = std::max(bucket.max_abs_log_error, abs_log_error);
+    if (!(abs_log_error <= sample.log_error_bound)) {
+        ++bucket.bound_violations;
+    }
+    bucket.exact_ns += sample.exact_ns;
+    bucket.approximation_ns += sample.approximation_ns;
+    ++bucket.error_histogram.at(error_bin(abs_log_error));
+}
+
+void ComparisonReport::merge(const ComparisonReport &other) {
+    std::lock(mutex, other.mutex);
+    std::lock_guard<std::mutex> lock(mutex, std::adopt_lock);
+    std::lock_guard<std::mutex> other_lock(other.mutex, std::adopt_lock);
+    for (const auto &key_bucket : other.buckets) {
+        const Bucket &from = key_bucket.second;
+        Bucket &to = buckets[key_bucket.first];
+        to.count += from.count;
+        to.sum_abs_log_error += from.sum_abs_log_error;
+        to.max_abs_log_error = std::max(to.max_abs_log_error, from.max_abs_log_error);
+        to.bound_violations += from.bound_violations;
+        to.exact_ns += from.exact_ns;
+        to.approximation_ns += from.approximation_ns;
+        for (int i = 0; i < N_ERROR_BINS; ++i) {
+            to.error_histogram[i] += from.error_histogram[i];
+        }
+    }
+}
+
+long ComparisonReport::size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    long size = 0;
+    for (const auto &key_bucket : buckets) {
+        size += key_bucket.second.count;
+    }
+    return size;
+}
+
+void ComparisonReport::write_csv(std::ostream &out) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    out << "n_negative_min,n_negative_max,dimensions,alpha,count,mean_abs_log_error,"
+        << "max_abs_log_error,bound_violations,mean_exact_ns,mean_approximation_ns";
+    out << ",error_below_1e" << MIN_ERROR_DECADE;
+    for (int decade = MIN_ERROR_DECADE; decade < 0; ++decade) {
+        out << ",error_below_1e" << decade + 1;
+    }
+    out << ",error_above_1" << std::endl;
+
+    for (const auto &key_bucket : buckets) {
+        const key_t &key = key_bucket.first;
+        const Bucket &bucket = key_bucket.second;
+        out << std::get<0>(key) << "," << 2 * std::get<0>(key) << "," << std::get<1>(key) << ","
+            << std::get<2>(key) << "," << bucket.count << ","
+            << bucket.sum_abs_log_error / bucket.count << "," << bucket.max_abs_log_error << ","
+            << bucket.bound_violations << "," << bucket.exact_ns / bucket.count << ","
+            << bucket.approximation_ns / bucket.count;
+        for (long count : bucket.error_histogram) {
+            out << "," << count;
+        }
+        out << std::endl;
+    }
+}
+
+}  // namespace FilterModel
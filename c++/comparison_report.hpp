@@ -0,0 +1,102 @@
+#ifndef COMPARISON_REPORT_HPP
+#define COMPARISON_REPORT_HPP
+
+/**
+ * Contains the in memory summary of the exact and approximate sums over k^- that --comparison
+ * collects.
+ */
+
+#include "types.hpp"
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace FilterModel {
+
+/**
+ * One sum over k^- evaluated both exactly and with the normal approximation.
+ */
+struct ComparisonSample {
+    int n_negative;
+    alpha_t alpha;
+    // Dimension of the approximating guassian.
+    int dimensions;
+    double log_exact;
+    double log_approximation;
+    // ApproximationDispatcher::log_error_bound of the approximation.
+    double log_error_bound;
+    double exact_ns;
+    double approximation_ns;
+};
+
+/**
+ * Aggregates ComparisonSamples into buckets of n^- (doubling ranges), dimension and alpha,
+ * keeping a histogram of the absolute log error by decade and the total time each method took, so
+ * that a run over production size data costs a few kilobytes rather than a log line per sum.
+ *
+ * Safe to use from several threads at once.
+ */
+class ComparisonReport {
+   public:
+    // Histogram bins: |log error| below 10^MIN_ERROR_DECADE, one bin per decade up to 1, and the
+    // rest (including non finite errors).
+    static const int MIN_ERROR_DECADE = -8;
+    static const int N_ERROR_BINS = 2 - MIN_ERROR_DECADE;
+
+    /**
+     * fraction: The fraction of sums to compare, spread evenly over the calls to should_sample.
+     */
+    explicit ComparisonReport(double fraction = 1.0);
+
+    ComparisonReport(const ComparisonReport &) = delete;
+    ComparisonReport &operator=(const ComparisonReport &) = delete;
+
+    /**
+     * Returns true for about fraction of the calls. Which calls depends on their order, so it can
+     * differ between runs with more than one thread.
+     */
+    bool should_sample();
+
+    void add(const ComparisonSample &sample);
+
+    /**
+     * Adds the buckets of other to this report.
+     */
+    void merge(const ComparisonReport &other);
+
+    long size() const;
+
+    /**
+     * Writes one csv row per bucket, with a header row.
+     */
+    void write_csv(std::ostream &out) const;
+
+   private:
+    struct Bucket {
+        long count = 0;
+        double sum_abs_log_error = 0;
+        double max_abs_log_error = 0;
+        // Samples whose error was larger than the dispatcher's bound.
+        long bound_violations = 0;
+        double exact_ns = 0;
+        double approximation_ns = 0;
+        std::vector<long> error_histogram = std::vector<long>(N_ERROR_BINS, 0);
+    };
+    // Lowest n^- of the bucket, dimensions, alpha as a bit string.
+    typedef std::tuple<int, int, std::string> key_t;
+
+    static int error_bin(double abs_log_error);
+
+    const double fraction;
+    std::atomic<long> calls{0};
+    mutable std::mutex mutex;
+    std::map<key_t, Bucket> buckets;
+};
+}  // namespace FilterModel
+
+#endif
@@ -0,0 +1,118 @@
+#include "convergence_diagnostics.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace FilterModel {
+
+namespace {
+
+/**
+ * Splits every chain into its first and second halves, dropping the middle draw of odd chains.
+ */
+std::vector<std::vector<double>> split_chains(const std::vector<std::vector<double>> &chains) {
+    std::vector<std::vector<double>> halves;
+    for (const std::vector<double> &chain : chains) {
+        int half = chain.size() / 2;
+        halves.push_back(std::vector<double>(chain.begin(), chain.begin() + half));
+        halves.push_back(std::vector<double>(chain.end() - half, chain.end()));
+    }
+    return halves;
+}
+
+double mean(const std::vector<double> &values) {
+    double sum = 0.0;
+    for (double value : values) {
+        sum += value;
+    }
+    return sum / values.size();
+}
+
+/**
+ * The within chain variance W and the estimate var+ of the marginal posterior variance.
+ */
+struct Variances {
+    double within;
+    double pooled;
+};
+
+Variances variances(const std::vector<std::vector<double>> &chains,
+                    std::vector<double> &chain_means) {
+    const int m = chains.size();
+    const int n = chains.front().size();
+    chain_means.clear();
+    for (const std::vector<double> &chain : chains) {
+        chain_means.push_back(mean(chain));
+    }
+    double grand_mean = mean(chain_means);
+
+    double between = 0.0;
+    double within = 0.0;
+    for (int j = 0; j < m; ++j) {
+        between += (chain_means[j] - grand_mean) * (chain_means[j] - grand_mean);
+        double chain_variance = 0.0;
+        for (double value : chains[j]) {
+            chain_variance += (value - chain_means[j]) * (value - chain_means[j]);
+        }
+        within += chain_variance / (n - 1);
+    }
+    between *= double(n) / (m - 1);
+    within /= m;
+    return {within, (n - 1.0) / n * within + between / n};
+}
+
+}  // namespace
+
+double split_r_hat(const std::vector<std::vector<double>> &chains) {
+    assert(!chains.empty() && chains.front().size() >= 4);
+    std::vector<std::vector<double>> halves = split_chains(chains);
+    std::vector<double> chain_means;
+    Variances v = variances(halves, chain_means);
+    if (v.within <= 0) {
+        return v.pooled <= 0 ? 1.0 : std::numeric_limits<double>::infinity();
+    }
+    return std::sqrt(v.pooled / v.within);
+}
+
+double effective_sample_size(const std::vector<std::vector<double>> &chains) {
+    assert(!chains.empty() && chains.front().size() >= 4);
+    std::vector<std::vector<double>> halves = split_chains(chains);
+    const int m = halves.size();
+    const int n = halves.front().size();
+    std::vector<double> chain_means;
+    Variances v = variances(halves, chain_means);
+    if (v.pooled <= 0) {
+        return double(m) * n;
+    }
+
+    // rho_t = 1 - (W - mean autocovariance at lag t) / var+.
+    auto autocorrelation = [&](int lag) {
+        double autocovariance = 0.0;
+        for (int j = 0; j < m; ++j) {
+            double sum = 0.0;
+            for (int i = 0; i + lag < n; ++i) {
+                sum += (halves[j][i] - chain_means[j]) * (halves[j][i + lag] - chain_means[j]);
+            }
+            autocovariance += sum / (n - 1);
+        }
+        autocovariance /= m;
+        return 1.0 - (v.within - autocovariance) / v.pooled;
+    };
+
+    // Sum the autocorrelations in pairs while the pair sums stay positive.
+    double tau = -1.0;
+    for (int lag = 0; lag + 1 < n; lag += 2) {
+        double pair = autocorrelation(lag) + autocorrelation(lag + 1);
+        if (pair < 0) {
+            break;
+        }
+        tau += 2 * pair;
+    }
+    // Antithetic chains can make tau tiny; cap the estimate at m n log10(m n) like Stan does.
+    return m * n / std::max(tau, 1.0 / std::log10(double(m) * n));
+}
+
+}  // namespace FilterModel
@@ -0,0 +1,32 @@
+#ifndef CONVERGENCE_DIAGNOSTICS_HPP
+#define CONVERGENCE_DIAGNOSTICS_HPP
+
+/**
+ * Contains the split R-hat and effective sample size diagnostics for several Markov chains, as
+ * described in Gelman et al., Bayesian Data Analysis (3rd edition), section 11.4 and 11.5.
+ */
+
+#include <vector>
+
+namespace FilterModel {
+
+/**
+ * Returns the potential scale reduction factor of the draws of a scalar in each chain, after
+ * splitting every chain into halves so that a chain that is still drifting also counts as not
+ * mixed. Values near 1 mean the chains agree; 1.01 is a common threshold.
+ *
+ * The chains must all have the same length, at least 4. Returns 1 if every draw is the same and
+ * infinity if each half chain is constant but they differ.
+ */
+double split_r_hat(const std::vector<std::vector<double>> &chains);
+
+/**
+ * Returns the effective number of independent draws in the (split) chains, from their
+ * autocorrelations combined across chains and summed with Geyer's initial positive sequence.
+ *
+ * Returns the number of draws if every draw is the same.
+ */
+double effective_sample_size(const std::vector<std::vector<double>> &chains);
+}  // namespace FilterModel
+
+#endif
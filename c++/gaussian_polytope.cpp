@@ -0,0 +1,215 @@
+#include "gaussian_polytope.hpp"
+
+#include <assert.h>
+#include <boost/log/trivial.hpp>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace FilterModel {
+
+namespace {
+
+const int N_QUADRATURE_POINTS = 20;
+
+/**
+ * Gauss-Legendre nodes and weights on [-1, 1].
+ */
+struct GaussLegendre {
+    double nodes[N_QUADRATURE_POINTS];
+    double weights[N_QUADRATURE_POINTS];
+
+    GaussLegendre() {
+        const int n = N_QUADRATURE_POINTS;
+        for (int i = 0; i < n; ++i) {
+            // Newton's method on P_n from the Chebyshev approximation of the i-th root.
+            double x = std::cos(M_PI * (i + 0.75) / (n + 0.5));
+            double derivative;
+            for (int iteration = 0; iteration < 100; ++iteration) {
+                double p_previous = 1;
+                double p = x;
+                for (int k = 2; k <= n; ++k) {
+                    double p_next = ((2 * k - 1) * x * p - (k - 1) * p_previous) / k;
+                    p_previous = p;
+                    p = p_next;
+                }
+                derivative = n * (x * p - p_previous) / (x * x - 1);
+                double step = p / derivative;
+                x -= step;
+                if (std::abs(step) < 1e-16) {
+                    break;
+                }
+            }
+            nodes[i] = x;
+            weights[i] = 2 / ((1 - x * x) * derivative * derivative);
+        }
+    }
+};
+
+const GaussLegendre &gauss_legendre() {
+    static const GaussLegendre rule;
+    return rule;
+}
+
+struct Point {
+    double x;
+    double y;
+};
+
+/**
+ * Returns the part of the convex polygon on the side a_x x + a_y y <= b of a line, keeping the
+ * polygon's orientation (Sutherland-Hodgman).
+ */
+std::vector<Point> clip(const std::vector<Point> &polygon, double a_x, double a_y, double b) {
+    std::vector<Point> out;
+    for (int i = 0; i < polygon.size(); ++i) {
+        const Point &from = polygon[i];
+        const Point &to = polygon[(i + 1) % polygon.size()];
+        double from_slack = b - a_x * from.x - a_y * from.y;
+        double to_slack = b - a_x * to.x - a_y * to.y;
+        if (from_slack >= 0) {
+            out.push_back(from);
+        }
+        if ((from_slack >= 0) != (to_slack >= 0)) {
+            double t = from_slack / (from_slack - to_slack);
+            out.push_back({from.x + t * (to.x - from.x), from.y + t * (to.y - from.y)});
+        }
+    }
+    return out;
+}
+
+/**
+ * Standard bivariate normal mass of the triangle with corners at the origin, the foot of the
+ * perpendicular to a line at distance d > 0, and the point s along the line from the foot.
+ */
+double foot_triangle_probability(double d, double s) {
+    return std::atan2(s, d) / (2 * M_PI) - owens_t(d, s / d);
+}
+
+double interval_probability(const std::vector<std::vector<double>> &covariance,
+                            const std::vector<std::vector<double>> &hyperplanes) {
+    double sigma = std::sqrt(covariance.at(0).at(0));
+
+    // Bounds on the standardised z = x / sigma.
+    double lower = -std::numeric_limits<double>::infinity();
+    double upper = std::numeric_limits<double>::infinity();
+    for (const std::vector<double> &hyperplane : hyperplanes) {
+        double a = hyperplane.at(0) * sigma;
+        double b = hyperplane.at(1);
+        if (a > 0) {
+            upper = std::min(upper, b / a);
+        } else if (a < 0) {
+            lower = std::max(lower, b / a);
+        } else if (b < 0) {
+            return 0;
+        }
+    }
+
+    if (lower >= upper) {
+        return 0;
+    }
+    // Use whichever tail keeps the difference away from cancellation.
+    if (lower > 0) {
+        return normal_cdf(-lower) - normal_cdf(-upper);
+    }
+    return normal_cdf(upper) - normal_cdf(lower);
+}
+
+double polygon_probability(const std::vector<std::vector<double>> &covariance,
+                           const std::vector<std::vector<double>> &hyperplanes) {
+    // Whiten with the cholesky factor L, x = L z, so a . x <= b becomes (L^T a) . z <= b.
+    double l_11 = std::sqrt(covariance.at(0).at(0));
+    double l_21 = covariance.at(1).at(0) / l_11;
+    double l_22 = std::sqrt(covariance.at(1).at(1) - l_21 * l_21);
+    if (!(l_22 > 0)) {
+        BOOST_LOG_TRIVIAL(fatal) << "gaussian_polytope_probability needs a positive definite "
+                                    "covariance matrix.";
+        assert(false);
+    }
+
+    // Mass further than this from the origin is below double precision, so clipping starts from
+    // this (counter clockwise) square rather than the whole plane.
+    const double radius = 40;
+    std::vector<Point> polygon = {
+        {-radius, -radius}, {radius, -radius}, {radius, radius}, {-radius, radius}};
+    for (const std::vector<double> &hyperplane : hyperplanes) {
+        double a_x = l_11 * hyperplane.at(0) + l_21 * hyperplane.at(1);
+        double a_y = l_22 * hyperplane.at(1);
+        polygon = clip(polygon, a_x, a_y, hyperplane.at(2));
+        if (polygon.empty()) {
+            return 0;
+        }
+    }
+
+    // Sum the signed triangles (origin, A, B) over the edges A -> B. Each is the difference of two
+    // triangles with a corner at the foot of the perpendicular from the origin to the edge.
+    double probability = 0;
+    for (int i = 0; i < polygon.size(); ++i) {
+        const Point &a = polygon[i];
+        const Point &b = polygon[(i + 1) % polygon.size()];
+        double length = std::hypot(b.x - a.x, b.y - a.y);
+        if (length == 0) {
+            continue;
+        }
+        double t_x = (b.x - a.x) / length;
+        double t_y = (b.y - a.y) / length;
+        double distance = (a.x * b.y - a.y * b.x) / length;
+        if (distance == 0) {
+            continue;
+        }
+        double triangle = foot_triangle_probability(std::abs(distance), t_x * b.x + t_y * b.y) -
+                          foot_triangle_probability(std::abs(distance), t_x * a.x + t_y * a.y);
+        probability += distance > 0 ? triangle : -triangle;
+    }
+    return std::max(probability, 0.0);
+}
+
+}  // namespace
+
+double normal_cdf(double x) { return 0.5 * std::erfc(-x / M_SQRT2); }
+
+double owens_t(double h, double a) {
+    if (a < 0) {
+        return -owens_t(h, -a);
+    }
+    h = std::abs(h);
+    if (a == 0) {
+        return 0;
+    }
+    if (std::isinf(a)) {
+        return normal_cdf(-h) / 2;
+    }
+    if (a > 1) {
+        // T(h, a) + T(ah, 1 / a) = (Q(h) + Q(ah)) / 2 - Q(h) Q(ah) for h >= 0, with Q = 1 - Phi.
+        double q_h = normal_cdf(-h);
+        double q_ah = normal_cdf(-a * h);
+        return (q_h + q_ah) / 2 - q_h * q_ah - owens_t(a * h, 1 / a);
+    }
+
+    const GaussLegendre &rule = gauss_legendre();
+    double sum = 0;
+    for (int i = 0; i < N_QUADRATURE_POINTS; ++i) {
+        double x = a * (rule.nodes[i] + 1) / 2;
+        double one_plus_x_squared = 1 + x * x;
+        sum += rule.weights[i] * std::exp(-h * h * one_plus_x_squared / 2) / one_plus_x_squared;
+    }
+    return sum * a / 2 / (2 * M_PI);
+}
+
+double gaussian_polytope_probability(const std::vector<std::vector<double>> &covariance,
+                                     const std::vector<std::vector<double>> &hyperplanes) {
+    switch (covariance.size()) {
+        case 1:
+            return interval_probability(covariance, hyperplanes);
+        case 2:
+            return polygon_probability(covariance, hyperplanes);
+        default:
+            BOOST_LOG_TRIVIAL(fatal) << "gaussian_polytope_probability only supports up to "
+                                     << MAX_CLOSED_FORM_DIMENSIONS << " dimensions, not "
+                                     << covariance.size() << ".";
+            assert(false);
+            return 0;
+    }
+}
+
+}  // namespace FilterModel
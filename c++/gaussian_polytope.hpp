@@ -0,0 +1,46 @@
+#ifndef GAUSSIAN_POLYTOPE_HPP
+#define GAUSSIAN_POLYTOPE_HPP
+
+/**
+ * Contains closed form probabilities of low dimensional guassians over convex polytopes.
+ */
+
+#include <vector>
+
+namespace FilterModel {
+
+/**
+ * The largest dimension gaussian_polytope_probability can integrate over.
+ */
+const int MAX_CLOSED_FORM_DIMENSIONS = 2;
+
+/**
+ * Returns P(Z <= x) for a standard normal Z.
+ */
+double normal_cdf(double x);
+
+/**
+ * Owen's T function, T(h, a) = 1 / (2 pi) int_0^a exp(-h^2 (1 + x^2) / 2) / (1 + x^2) dx.
+ *
+ * This is the building block of the Drezner/Genz bivariate normal CDF routines. T(h, atan(psi)) is
+ * the mass of a standard bivariate normal in the wedge of angle psi at the origin beyond a line at
+ * distance h, which is what gaussian_polytope_probability needs.
+ */
+double owens_t(double h, double a);
+
+/**
+ * Returns the probability that a zero mean guassian lies inside a convex polytope, in closed form.
+ *
+ * covariance: The lower triangle (or all) of the guassian's covariance matrix, as passed to MVI3.
+ * hyperplanes: One row per constraint a_1 x_1 + ... + a_d x_d <= b, stored as [a_1, ..., a_d, b].
+ *
+ * Only dimensions d <= MAX_CLOSED_FORM_DIMENSIONS are supported. In one dimension the polytope is
+ * an interval. In two, the guassian is whitened and the polygon is split into one triangle per
+ * edge with a corner at the origin, each of which is a difference of Owen's T values. The result is
+ * deterministic and accurate to about 1e-12, in place of MVI3's Monte Carlo estimate.
+ */
+double gaussian_polytope_probability(const std::vector<std::vector<double>> &covariance,
+                                     const std::vector<std::vector<double>> &hyperplanes);
+}  // namespace FilterModel
+
+#endif
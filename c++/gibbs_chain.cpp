@@ -0,0 +1,137 @@
+#include "gibbs_chain.hpp"
+
+#include "metropolis_hastings.hpp"
+#include "model_distribution.hpp"
+#include "sample_models.hpp"
+#include "utils.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <vector>
+
+namespace FilterModel {
+
+GibbsChain::GibbsChain(const std::vector<category_counts_t> &data, const Options &options,
+                       std::default_random_engine::result_type seed)
+    : options(options),
+      n_categories(data.empty() ? 0 : data.at(0).size()),
+      generator(seed),
+      parameter_distribution(0.0, 1.0),
+      model_distribution(data, options),
+      sampler(data, seed, options),
+      epsilon_scale(0.25, 0.44),
+      delta_scale(0.25),
+      last_log_likelyhood(NAN) {
+    if (options.tries > 1) {
+        proposal_pool.reset(new ThreadPool(options.tries));
+    }
+    epsilons.push_back(parameter_distribution(generator));
+    deltas.push_back(sample_symmetric_simplex(parameter_distribution, generator, n_categories));
+    models.push_back(std::vector<alpha_t>());
+    epsilon_acceptance.push_back(NAN);
+    delta_acceptance.push_back(NAN);
+    epsilon_scales.push_back(epsilon_scale.get());
+    delta_scales.push_back(delta_scale.get());
+    if (options.record_likelyhood) {
+        log_likelyhoods.push_back(NAN);
+    }
+}
+
+namespace {
+
+/**
+ * Returns the fraction of the proposals since the given counts that were accepted.
+ */
+double acceptance_since(const ProposalScale &scale, long proposals, long accepted) {
+    return double(scale.get_accepted() - accepted) / (scale.get_proposals() - proposals);
+}
+
+}  // namespace
+
+void GibbsChain::step() {
+    bool adapting = size() <= options.adapt_iterations;
+    epsilon_scale.set_adapting(adapting);
+    delta_scale.set_adapting(adapting);
+    long epsilon_proposals = epsilon_scale.get_proposals();
+    long epsilon_accepted = epsilon_scale.get_accepted();
+    long delta_proposals = delta_scale.get_proposals();
+    long delta_accepted = delta_scale.get_accepted();
+
+    if (options.fixed_alphas.empty()) {
+        // The sampler's table gives the likelyhood of the new model at the current epsilon and
+        // delta, where the epsilon step starts.
+        std::vector<double> model_log_likelyhoods;
+        models.push_back(sampler.sample(epsilons.back(), deltas.back(), &model_log_likelyhoods));
+        last_log_likelyhood =
+            std::accumulate(model_log_likelyhoods.begin(), model_log_likelyhoods.end(), 0.0);
+    } else {
+        models.push_back(options.fixed_alphas);
+    }
+
+    // Each Metropolis-Hastings run starts from the previous value. Both log pdfs are the log
+    // likelyhood of the model, epsilon and delta, so the last one carries over.
+    MetropolisHastingsState<double> epsilon_state =
+        MetropolisHastingsSampler::sample_multiple_try_from<double, std::default_random_engine>(
+            10,  // Iterations
+            options.tries, {epsilons.back(), last_log_likelyhood},
+            [delta = deltas.back(), model = models.back(),
+             model_distribution = model_distribution](double epsilon) {
+                std::vector<std::vector<alpha_t>> alphas_per_object(model.size());
+                for (int i = 0; i < alphas_per_object.size(); ++i) {
+                    alphas_per_object.at(i) = std::vector<alpha_t>(1, model.at(i));
+                }
+                std::vector<std::vector<double>> log_alpha_likelyhoods_per_object =
+                    model_distribution.distribution(alphas_per_object, epsilon, delta);
+                std::vector<double> log_alpha_likelyhoods(log_alpha_likelyhoods_per_object.size());
+                std::transform(log_alpha_likelyhoods_per_object.begin(),
+                               log_alpha_likelyhoods_per_object.end(),
+                               log_alpha_likelyhoods.begin(),
+                               [](std::vector<double> v) { return v[0]; });
+
+                return std::accumulate(log_alpha_likelyhoods.begin(), log_alpha_likelyhoods.end(),
+                                       0.0);
+            },  // log_pdf
+            [this](double center, std::default_random_engine &generator) {
+                std::normal_distribution<> dist(center, epsilon_scale.get());
+                return sample_probability(dist, generator);
+            },  // conditional_sampler
+            generator, proposal_pool.get(), nullptr, &epsilon_scale);
+    epsilons.push_back(epsilon_state.value);
+
+    MetropolisHastingsState<delta_t> delta_state =
+        MetropolisHastingsSampler::sample_multiple_try_from<delta_t, std::default_random_engine>(
+            10,  // Iterations
+            options.tries, {deltas.back(), epsilon_state.log_pdf},
+            [epsilon = epsilons.back(), model = models.back(),
+             model_distribution = model_distribution](delta_t delta) {
+                std::vector<std::vector<alpha_t>> alphas_per_object(model.size());
+                for (int i = 0; i < alphas_per_object.size(); ++i) {
+                    alphas_per_object.at(i) = std::vector<alpha_t>(1, model.at(i));
+                }
+                std::vector<std::vector<double>> log_alpha_likelyhoods_per_object =
+                    model_distribution.distribution(alphas_per_object, epsilon, delta);
+                std::vector<double> log_alpha_likelyhoods =
+                    flatten<double>(log_alpha_likelyhoods_per_object);
+
+                return accumulate(log_alpha_likelyhoods.begin(), log_alpha_likelyhoods.end(), 0.0);
+            },  // log_pdf
+            [this](delta_t center, std::default_random_engine &generator) {
+                return sample_gaussian_simplex<>(center, delta_scale.get(), generator);
+            },  // Conditional sampler
+            generator, proposal_pool.get(), nullptr, &delta_scale);
+    deltas.push_back(delta_state.value);
+    last_log_likelyhood = delta_state.log_pdf;
+    epsilon_acceptance.push_back(
+        acceptance_since(epsilon_scale, epsilon_proposals, epsilon_accepted));
+    delta_acceptance.push_back(acceptance_since(delta_scale, delta_proposals, delta_accepted));
+    epsilon_scales.push_back(epsilon_scale.get());
+    delta_scales.push_back(delta_scale.get());
+
+    if (options.record_likelyhood) {
+        log_likelyhoods.push_back(last_log_likelyhood);
+    }
+}
+
+}  // namespace FilterModel
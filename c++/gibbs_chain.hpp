@@ -0,0 +1,105 @@
+#ifndef GIBBS_CHAIN_HPP
+#define GIBBS_CHAIN_HPP
+
+/**
+ * Contains one chain of the Gibbs sampler over alpha, epsilon and delta.
+ */
+
+#include "metropolis_hastings.hpp"
+#include "model_distribution.hpp"
+#include "sample_models.hpp"
+#include "thread_pool.hpp"
+#include "types.hpp"
+
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace FilterModel {
+
+/**
+ * A Gibbs chain with its own random number generator, likelyhood and alpha sampler.
+ *
+ * Each step samples alpha -> epsilon -> delta, the last two with Metropolis-Hastings started
+ * from their previous values and trying options.tries candidates at a time on a pool of as many
+ * threads. Their proposal scales adapt toward a target acceptance rate for the first
+ * options.adapt_iterations steps and are fixed after that. The chain keeps every state,
+ * starting with the initial epsilon and delta and an empty model, so index i of each trace is
+ * the state after i steps.
+ *
+ * Chains own their thread pools, so they can't be copied.
+ */
+class GibbsChain {
+   public:
+    /**
+     * seed: Seeds the chain's generator, which also draws the initial epsilon and delta, and
+     *   keys the alpha sampler's streams.
+     */
+    GibbsChain(const std::vector<category_counts_t> &data, const Options &options,
+               std::default_random_engine::result_type seed);
+
+    GibbsChain(const GibbsChain &) = delete;
+    GibbsChain &operator=(const GibbsChain &) = delete;
+
+    /**
+     * Runs one Gibbs iteration, appending the new state to the traces.
+     */
+    void step();
+
+    /**
+     * Returns the number of states in the traces, one more than the number of steps taken.
+     */
+    int size() const { return epsilons.size(); }
+
+    const std::vector<std::vector<alpha_t>> &get_models() const { return models; }
+    const std::vector<double> &get_epsilons() const { return epsilons; }
+    const std::vector<delta_t> &get_deltas() const { return deltas; }
+    /**
+     * The log likelyhood of each state if options.record_likelyhood is set, NaN for the initial
+     * state. Empty otherwise.
+     */
+    const std::vector<double> &get_log_likelyhoods() const { return log_likelyhoods; }
+    /**
+     * The fraction of epsilon and delta proposals accepted in each step, NaN for the initial
+     * state.
+     */
+    const std::vector<double> &get_epsilon_acceptance() const { return epsilon_acceptance; }
+    const std::vector<double> &get_delta_acceptance() const { return delta_acceptance; }
+    /**
+     * The epsilon and delta proposal scales after each step, starting with the initial scales.
+     */
+    const std::vector<double> &get_epsilon_scales() const { return epsilon_scales; }
+    const std::vector<double> &get_delta_scales() const { return delta_scales; }
+
+    const ProposalScale &get_epsilon_scale() const { return epsilon_scale; }
+    const ProposalScale &get_delta_scale() const { return delta_scale; }
+
+    const ModelDistribution &get_model_distribution() const { return model_distribution; }
+    const ModelSampler &get_sampler() const { return sampler; }
+
+   private:
+    const Options options;
+    const int n_categories;
+    std::default_random_engine generator;
+    std::uniform_real_distribution<double> parameter_distribution;
+    ModelDistribution model_distribution;
+    ModelSampler sampler;
+    // Evaluates the Metropolis-Hastings candidates. Null unless options.tries > 1.
+    std::unique_ptr<ThreadPool> proposal_pool;
+    ProposalScale epsilon_scale;
+    ProposalScale delta_scale;
+    // Log likelyhood of the last model, epsilon and delta, NaN before the first step.
+    double last_log_likelyhood;
+
+    std::vector<std::vector<alpha_t>> models;
+    std::vector<double> epsilons;
+    std::vector<delta_t> deltas;
+    std::vector<double> log_likelyhoods;
+    std::vector<double> epsilon_acceptance;
+    std::vector<double> delta_acceptance;
+    std::vector<double> epsilon_scales;
+    std::vector<double> delta_scales;
+};
+}  // namespace FilterModel
+
+#endif
@@ -1,3 +1,4 @@
+#include "k_negative_enumerator.hpp"
 #include "multinomial.hpp"
 #include "types.hpp"
 #include "utils.hpp"
@@ -11,6 +12,27 @@
 
 using namespace FilterModel;
 
+/**
+ * Collects log(p(k^- | n^-, delta)) for every valid k^- with the given first component.
+ */
+template <int N>
+struct InnerLoopTerms {
+    static std::vector<double> run(int n_positive, int n_negative, const alpha_t &alpha,
+                                   const std::vector<double> &delta,
+                                   const category_counts_t &object_counts, int k_1_negative) {
+        Multinomial m(n_negative, delta);
+        std::vector<double> terms;
+        KNegativeEnumerator<N>::points(
+            [&terms, &m, k_1_negative](const int *k_negative) {
+                if (k_negative[0] == k_1_negative) {
+                    terms.push_back(m.log_pdf(std::vector<int>(k_negative, k_negative + N)));
+                }
+            },
+            n_positive, n_negative, alpha, object_counts);
+        return terms;
+    }
+};
+
 int main(int argc, char *const *argv) {
     // Setting up command line flags.
     CLI::App app{"Inner Loop"};
@@ -22,13 +44,13 @@ int main(int argc, char *const *argv) {
     app.add_option("--n-negative", n_negative, "")->required();
 
     std::vector<std::string> alpha_s;
-    app.add_option("-a", alpha_s, "")->required()->expected(3);
+    app.add_option("-a", alpha_s, "")->required();
 
     std::vector<std::string> delta_s;
-    app.add_option("-d", delta_s, "")->required()->expected(3);
+    app.add_option("-d", delta_s, "")->required();
 
     std::vector<std::string> object_counts_s;
-    app.add_option("-k", object_counts_s, "")->required()->expected(3);
+    app.add_option("-k", object_counts_s, "")->required();
 
     int k_1_negative;
     app.add_option("--k-1-negative", k_1_negative, "")->required();
@@ -38,40 +60,28 @@ int main(int argc, char *const *argv) {
 
     CLI11_PARSE(app, argc, argv);
 
-    alpha_t alpha = {alpha_s[0] == "1", alpha_s[1] == "1", alpha_s[2] == "1"};
+    if (delta_s.size() != alpha_s.size() || object_counts_s.size() != alpha_s.size()) {
+        std::cerr << "-a, -d and -k need one value per category." << std::endl;
+        return 1;
+    }
+
+    alpha_t alpha;
+    for (const std::string &s : alpha_s) {
+        alpha.push_back(s == "1");
+    }
 
-    std::vector<double> delta(3);
+    std::vector<double> delta(delta_s.size());
     std::transform(delta_s.begin(), delta_s.end(), delta.begin(), [](std::string s) -> double {
         double test = std::stod(s);
         return test;
     });
 
-    category_counts_t object_counts(3);
+    category_counts_t object_counts(object_counts_s.size());
     std::transform(object_counts_s.begin(), object_counts_s.end(), object_counts.begin(),
                    [](const std::string &s) -> int { return std::stoi(s); });
 
-    std::vector<int> fixed_k_negative = {0, 0, 0};
-    for (int i = 0; i < 3; ++i) {
-        if (alpha.at(i) == false) {
-            fixed_k_negative.at(i) = object_counts.at(i);
-        }
-    }
-
-    Multinomial m(n_negative, delta);
-
-    std::vector<double> terms;
-
-    for (int k_2_negative = std::max({object_counts[1] - n_positive, fixed_k_negative[1],
-                                      n_negative - k_1_negative - object_counts[2]});
-         k_2_negative <=
-         std::min(n_negative - k_1_negative - fixed_k_negative[2], object_counts[1]);
-         ++k_2_negative) {
-        int k_3_negative = n_negative - k_1_negative - k_2_negative;
-        if (alpha[2] == false && k_3_negative == object_counts[2] ||
-            alpha[2] == true && k_3_negative >= 0 && k_3_negative <= object_counts[2]) {
-            terms.push_back(m.log_pdf({k_1_negative, k_2_negative, k_3_negative}));
-        }
-    }
+    std::vector<double> terms = dispatch_categories<InnerLoopTerms>(
+        alpha.size(), n_positive, n_negative, alpha, delta, object_counts, k_1_negative);
 
     double partial_sum = stable_sum<double>(terms);
 
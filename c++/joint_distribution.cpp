@@ -4,8 +4,12 @@
  * Argument Structure Acquisition" by Perkins, Feldman, and Lidz. See the paper for details.
  */
 
-#include "metropolis_hastings.hpp"
-#include "sample_models.hpp"
+#include "approximation_dispatcher.hpp"
+#include "comparison_report.hpp"
+#include "convergence_diagnostics.hpp"
+#include "gibbs_chain.hpp"
+#include "k_negative_enumerator.hpp"
+#include "thread_pool.hpp"
 #include "utils.hpp"
 
 #include <CLI/CLI.hpp>
@@ -13,155 +17,218 @@
 #include <boost/log/core.hpp>
 #include <boost/log/expressions.hpp>
 #include <boost/log/trivial.hpp>
+#include <algorithm>
 #include <chrono>
+#include <cstdint>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <limits>
+#include <memory>
 #include <random>
+#include <sstream>
 #include <string>
-#include <tuple>
 #include <utility>
+#include <vector>
 
 using namespace FilterModel;
 namespace logging = boost::log;
 
+/**
+ * Summary of the split R-hat and effective sample size of every sampled quantity.
+ */
+struct ConvergenceSummary {
+    double epsilon_r_hat;
+    double epsilon_ess;
+    // The largest R-hat and smallest effective sample size over the components of delta.
+    double delta_r_hat;
+    double delta_ess;
+    // The same over alpha_i of every object, i.e. the frequency each category is allowed.
+    double alpha_r_hat;
+    double alpha_ess;
+
+    double max_r_hat() const { return std::max({epsilon_r_hat, delta_r_hat, alpha_r_hat}); }
+    double min_ess() const { return std::min({epsilon_ess, delta_ess, alpha_ess}); }
+};
+
+/**
+ * Computes the diagnostics over the second half of the states of every chain, treating the first
+ * half as warm up. Every chain must have at least 8 states.
+ */
+ConvergenceSummary summarise_convergence(const std::vector<std::unique_ptr<GibbsChain>> &chains) {
+    const int size = chains.front()->size();
+    const int first = size / 2;
+    auto diagnose = [&chains, first, size](const std::function<double(const GibbsChain &, int)> &f,
+                                           double &r_hat, double &ess) {
+        std::vector<std::vector<double>> draws;
+        for (const std::unique_ptr<GibbsChain> &chain : chains) {
+            std::vector<double> chain_draws;
+            for (int i = first; i < size; ++i) {
+                chain_draws.push_back(f(*chain, i));
+            }
+            draws.push_back(chain_draws);
+        }
+        r_hat = std::max(r_hat, split_r_hat(draws));
+        ess = std::min(ess, effective_sample_size(draws));
+    };
+
+    const double infinity = std::numeric_limits<double>::infinity();
+    ConvergenceSummary summary = {1.0, infinity, 1.0, infinity, 1.0, infinity};
+    diagnose([](const GibbsChain &chain, int i) { return chain.get_epsilons().at(i); },
+             summary.epsilon_r_hat, summary.epsilon_ess);
+    const GibbsChain &first_chain = *chains.front();
+    for (int c = 0; c < first_chain.get_deltas().front().size(); ++c) {
+        diagnose([c](const GibbsChain &chain, int i) { return chain.get_deltas().at(i).at(c); },
+                 summary.delta_r_hat, summary.delta_ess);
+    }
+    for (int object = 0; object < first_chain.get_models().back().size(); ++object) {
+        for (int c = 0; c < first_chain.get_models().back().at(object).size(); ++c) {
+            diagnose(
+                [object, c](const GibbsChain &chain, int i) {
+                    return double(chain.get_models().at(i).at(object)[c]);
+                },
+                summary.alpha_r_hat, summary.alpha_ess);
+        }
+    }
+    return summary;
+}
+
 /**
  * Jointly inferrs the alpha vector of each object, the epsilon, and the delta value for some
- * objects by using a fixed number of iterations of gibbs sampling.
+ * objects by using a fixed number of iterations of gibbs sampling in options.chains independent
+ * chains.
  *
  * The sampling uses the following flow:
  *   alpha -> epsilon -> delta.
  *
- * This function takes as input a vector of category count vectors of each object and the number of
- * iterations or time steps to sample over.
+ * The chains run concurrently on their own threads, each with its own generator (seeded from
+ * options.seed and the chain index) and initial epsilon and delta, and share the loaded data. Every
+ * batch_size iterations, write_batch is called with each chain's index and its new alphas,
+ * epsilons, deltas, (if recorded) log likelyhoods, and the epsilon and delta acceptance rates and
+ * proposal scales of each step. With more than one chain the split R-hat and
+ * effective sample size of epsilon, delta and each object's alpha are then logged, and if
+ * options.stop_r_hat is positive sampling stops once every R-hat is at most options.stop_r_hat
+ * and every effective sample size at least options.stop_ess.
  *
- * This function outputs a tuple of three vectors. The first vector contains the sampled
- * alpha of each object in the data at each time step. So the first element of outer vector
- * is a vector of alphas sampled at the first time step, the second element is the
- * alphas at the second time step, etc. The second and third vectors are the sampled epsilon
- * and delta values at each time step respectively.
+ * Returns the chains, whose traces hold every sampled state.
  */
-std::tuple<std::vector<std::vector<alpha_t>>, std::vector<double>, std::vector<delta_t>,
-           std::vector<double>>
-joint_inference(std::vector<category_counts_t> &data, int iterations,
-                std::function<void(std::vector<std::vector<alpha_t>>, std::vector<double>,
-                                   std::vector<delta_t>, std::vector<double>)>
-                    write_batch,
-                int batch_size, Options options) {
+std::vector<std::unique_ptr<GibbsChain>> joint_inference(
+    std::vector<category_counts_t> &data, int iterations,
+    std::function<void(int, std::vector<std::vector<alpha_t>>, std::vector<double>,
+                       std::vector<delta_t>, std::vector<double>, std::vector<double>,
+                       std::vector<double>, std::vector<double>, std::vector<double>)>
+        write_batch,
+    int batch_size, Options options) {
     BOOST_LOG_TRIVIAL(info) << "Starting Gibbs Sampling";
 
-    int n_categories = 0;
-    if (data.size() > 0) {
-        n_categories = data.at(0).size();
+    std::vector<std::unique_ptr<GibbsChain>> chains;
+    for (int chain = 0; chain < options.chains; ++chain) {
+        std::seed_seq seeds{uint32_t(options.seed), uint32_t(options.seed >> 32), uint32_t(chain)};
+        std::vector<uint32_t> seed(1);
+        seeds.generate(seed.begin(), seed.end());
+        chains.push_back(std::unique_ptr<GibbsChain>(new GibbsChain(data, options, seed[0])));
     }
 
-    std::default_random_engine generator;
-    generator.seed(std::chrono::system_clock::now().time_since_epoch().count());
-
-    std::uniform_real_distribution<double> parameter_distribution(0.0, 1.0);
-    std::vector<double> epsilons = {parameter_distribution(generator)};
-    std::vector<delta_t> deltas = {
-        sample_symmetric_simplex(parameter_distribution, generator, n_categories)};
-    // Each item contains a vector of the estimated alpha of each object at each timestep.
-    std::vector<std::vector<alpha_t>> models;
-    models.push_back(std::vector<alpha_t>());
-
-    ModelDistribution model_distribution(data, generator, options);
-    ModelSampler sampler(data, generator, options);
-
-    std::vector<double> log_likelyhoods;
+    // Each chain's likelyhood has its own options.threads thread pool, so the pools never nest.
+    ThreadPool chain_pool(options.chains);
+    for (int start = 0; start <= iterations; start += batch_size) {
+        int end = std::min(start + batch_size, iterations + 1);
+        chain_pool.parallel_for(chains.size(), [&chains, end](int chain) {
+            while (chains[chain]->size() < end) {
+                BOOST_LOG_TRIVIAL(info) << "Iteration " << chains[chain]->size()
+                                        << (chains.size() > 1
+                                                ? " of chain " + std::to_string(chain)
+                                                : std::string());
+                chains[chain]->step();
+            }
+        });
 
-    for (int iteration = 1; iteration <= iterations; ++iteration) {
-        BOOST_LOG_TRIVIAL(info) << "Iteration " << iteration;
+        for (int chain = 0; chain < chains.size(); ++chain) {
+            const GibbsChain &c = *chains[chain];
+            std::vector<double> log_likelyhood_batch;
+            if (options.record_likelyhood) {
+                log_likelyhood_batch = std::vector<double>(
+                    c.get_log_likelyhoods().begin() + start, c.get_log_likelyhoods().begin() + end);
+            }
+            write_batch(chain,
+                        std::vector<std::vector<alpha_t>>(c.get_models().begin() + start,
+                                                          c.get_models().begin() + end),
+                        std::vector<double>(c.get_epsilons().begin() + start,
+                                            c.get_epsilons().begin() + end),
+                        std::vector<delta_t>(c.get_deltas().begin() + start,
+                                             c.get_deltas().begin() + end),
+                        log_likelyhood_batch,
+                        std::vector<double>(c.get_epsilon_acceptance().begin() + start,
+                                            c.get_epsilon_acceptance().begin() + end),
+                        std::vector<double>(c.get_delta_acceptance().begin() + start,
+                                            c.get_delta_acceptance().begin() + end),
+                        std::vector<double>(c.get_epsilon_scales().begin() + start,
+                                            c.get_epsilon_scales().begin() + end),
+                        std::vector<double>(c.get_delta_scales().begin() + start,
+                                            c.get_delta_scales().begin() + end));
+
+            // Mean acceptance over the steps in this batch; index 0 is the initial state.
+            int first = std::max(start, 1);
+            double epsilon_acceptance = 0;
+            double delta_acceptance = 0;
+            for (int i = first; i < end; ++i) {
+                epsilon_acceptance += c.get_epsilon_acceptance()[i] / (end - first);
+                delta_acceptance += c.get_delta_acceptance()[i] / (end - first);
+            }
+            if (end > first) {
+                BOOST_LOG_TRIVIAL(info)
+                    << "Acceptance rate"
+                    << (chains.size() > 1 ? " of chain " + std::to_string(chain) : std::string())
+                    << " up to iteration " << end - 1 << ": epsilon " << epsilon_acceptance
+                    << " (scale " << c.get_epsilon_scale().get() << "), delta " << delta_acceptance
+                    << " (scale " << c.get_delta_scale().get() << ").";
+            }
+        }
 
-        if (options.fixed_alphas.empty()) {
-            std::vector<alpha_t> new_models =
-                sampler.sample(epsilons.at(iteration - 1), deltas.at(iteration - 1));
-            models.push_back(new_models);
-        } else {
-            models.push_back(options.fixed_alphas);
+        if (chains.size() > 1 && end >= 8) {
+            ConvergenceSummary summary = summarise_convergence(chains);
+            BOOST_LOG_TRIVIAL(info)
+                << "Split R-hat and effective sample size after " << end - 1
+                << " iterations: epsilon " << summary.epsilon_r_hat << ", " << summary.epsilon_ess
+                << "; delta " << summary.delta_r_hat << ", " << summary.delta_ess << "; alpha "
+                << summary.alpha_r_hat << ", " << summary.alpha_ess << ".";
+            if (options.stop_r_hat > 0 && summary.max_r_hat() <= options.stop_r_hat &&
+                summary.min_ess() >= options.stop_ess) {
+                BOOST_LOG_TRIVIAL(info) << "Chains converged, stopping.";
+                break;
+            }
         }
+    }
 
-        epsilons.push_back(MetropolisHastingsSampler::sample<double, std::default_random_engine>(
-            10,  // Iterations
-            [delta = deltas.at(iteration - 1), model = models.at(iteration),
-             model_distribution](double epsilon) {
-                std::vector<std::vector<alpha_t>> alphas_per_object(model.size());
-                for (int i = 0; i < alphas_per_object.size(); ++i) {
-                    alphas_per_object.at(i) = std::vector<alpha_t>(1, model.at(i));
-                }
-                std::vector<std::vector<double>> log_alpha_likelyhoods_per_object =
-                    model_distribution.distribution(alphas_per_object, epsilon, delta);
-                std::vector<double> log_alpha_likelyhoods(log_alpha_likelyhoods_per_object.size());
-                std::transform(log_alpha_likelyhoods_per_object.begin(),
-                               log_alpha_likelyhoods_per_object.end(),
-                               log_alpha_likelyhoods.begin(),
-                               [](std::vector<double> v) { return v[0]; });
-
-                return std::accumulate(log_alpha_likelyhoods.begin(), log_alpha_likelyhoods.end(),
-                                       0.0);
-            },  // log_pdf
-            [&parameter_distribution](std::default_random_engine &generator) {
-                return parameter_distribution(generator);
-            },  // uniform_sampler
-            [](double center, std::default_random_engine &generator) {
-                std::normal_distribution<> dist(center, 0.25);
-                return sample_probability(dist, generator);
-            },  // conditional_sampler
-            generator));
-
-        deltas.push_back(MetropolisHastingsSampler::sample<delta_t, std::default_random_engine>(
-            10,  // Iterations
-            [epsilon = epsilons.at(iteration), model = models.at(iteration),
-             model_distribution](delta_t delta) {
-                std::vector<std::vector<alpha_t>> alphas_per_object(model.size());
-                for (int i = 0; i < alphas_per_object.size(); ++i) {
-                    alphas_per_object.at(i) = std::vector<alpha_t>(1, model.at(i));
-                }
-                std::vector<std::vector<double>> log_alpha_likelyhoods_per_object =
-                    model_distribution.distribution(alphas_per_object, epsilon, delta);
-                std::vector<double> log_alpha_likelyhoods =
-                    flatten<double>(log_alpha_likelyhoods_per_object);
-
-                return accumulate(log_alpha_likelyhoods.begin(), log_alpha_likelyhoods.end(), 0.0);
-            },  // log_pdf
-            [parameter_distribution, n_categories](std::default_random_engine &generator) {
-                return sample_symmetric_simplex(parameter_distribution, generator, n_categories);
-            },  // uniform_sampler
-            [](delta_t center, std::default_random_engine &generator) {
-                return sample_gaussian_simplex<>(center, 0.25, generator);
-            },  // Conditional sampler
-            generator));
-
-        if (options.record_likelyhood) {
-            std::vector<double> log_likelyhood_per_object =
-                flatten<double>(model_distribution.distribution(
-                    models.at(iteration), epsilons.at(iteration), deltas.at(iteration)));
-            log_likelyhoods.push_back(std::accumulate(log_likelyhood_per_object.begin(),
-                                                      log_likelyhood_per_object.end(), 0.0));
+    if (options.comparison) {
+        ComparisonReport report;
+        for (const std::unique_ptr<GibbsChain> &chain : chains) {
+            report.merge(*chain->get_model_distribution().get_comparison_report());
+            report.merge(*chain->get_sampler().get_model_distribution().get_comparison_report());
         }
+        std::ofstream report_file(options.comparison_report_path,
+                                  std::ios::out | std::ios::trunc);
+        report.write_csv(report_file);
+        BOOST_LOG_TRIVIAL(info) << "Wrote " << report.size() << " comparisons to "
+                                << options.comparison_report_path << ".";
+    }
 
-        if (iteration % batch_size == batch_size - 1 || iteration == iterations) {
-            int batch = iteration / batch_size + 1;
-            int start_index = (batch - 1) * batch_size;
-            int end_index = std::min(batch * batch_size, iterations + 1);
-
-            std::vector<std::vector<alpha_t>> alpha_batch(models.begin() + start_index,
-                                                          models.begin() + end_index);
-            std::vector<double> epsilon_batch(epsilons.begin() + start_index,
-                                              epsilons.begin() + end_index);
-            std::vector<delta_t> delta_batch(deltas.begin() + start_index,
-                                             deltas.begin() + end_index);
-            std::vector<double> log_likelyhood_batch;
-            if (options.record_likelyhood) {
-                log_likelyhood_batch = std::vector<double>(log_likelyhoods.begin() + start_index,
-                                                           log_likelyhoods.begin() + end_index);
+    if (options.truncation_tolerance > 0) {
+        long skipped = 0;
+        long evaluated = 0;
+        for (const std::unique_ptr<GibbsChain> &chain : chains) {
+            for (const ModelDistribution *model_distribution :
+                 {&chain->get_model_distribution(),
+                  &chain->get_sampler().get_model_distribution()}) {
+                skipped += model_distribution->get_skipped_terms();
+                evaluated += model_distribution->get_evaluated_terms();
             }
-
-            write_batch(alpha_batch, epsilon_batch, delta_batch, log_likelyhood_batch);
         }
+        BOOST_LOG_TRIVIAL(info) << "Truncation skipped " << skipped << " of " << skipped + evaluated
+                                << " n+ terms.";
     }
 
-    return std::make_tuple(models, epsilons, deltas, log_likelyhoods);
+    return chains;
 }
 
 /**
@@ -179,8 +246,18 @@ std::vector<category_counts_t> read_category_counts_file(std::string in_path) {
         while (getline(in_file, line)) {
             std::vector<std::string> items;
             boost::split(items, line, boost::is_any_of(","));
-            category_counts_t datum = {std::stoi(items.at(1)), std::stoi(items.at(2)),
-                                       std::stoi(items.at(3))};
+            // The first column is the object name, every other column is a category.
+            category_counts_t datum;
+            for (int i = 1; i < items.size(); ++i) {
+                datum.push_back(std::stoi(items.at(i)));
+            }
+            if (datum.empty() || datum.size() > MAX_CATEGORIES ||
+                (!data.empty() && datum.size() != data.front().size())) {
+                BOOST_LOG_TRIVIAL(fatal) << "Every row of " << in_path << " needs the same number "
+                                         << "of categories, between 1 and " << MAX_CATEGORIES
+                                         << ".";
+                assert(false);
+            }
             data.push_back(datum);
         }
         in_file.close();
@@ -202,8 +279,10 @@ std::vector<alpha_t> read_alphas(std::string alpha_path) {
         while (getline(in_file, line)) {
             std::vector<std::string> items;
             boost::split(items, line, boost::is_any_of(","));
-            alpha_t alpha = {bool(std::stoi(items.at(1))), bool(std::stoi(items.at(2))),
-                             bool(std::stoi(items.at(3)))};
+            alpha_t alpha;
+            for (int i = 1; i < items.size(); ++i) {
+                alpha.push_back(bool(std::stoi(items.at(i))));
+            }
             alphas.push_back(alpha);
         }
         in_file.close();
@@ -219,6 +298,20 @@ std::ofstream setup_output(std::string out_path) {
     return std::ofstream(out_path, std::ios::out | std::ios::trunc);
 }
 
+/**
+ * Returns where one of several chains is written: out_path with _chain<chain> before the
+ * extension of its file name, e.g. out/run_chain1.out for out/run.out.
+ */
+std::string chain_output_path(const std::string &out_path, int chain) {
+    size_t name_start = out_path.find_last_of('/');
+    size_t extension = out_path.find('.', name_start == std::string::npos ? 0 : name_start);
+    if (extension == std::string::npos) {
+        extension = out_path.size();
+    }
+    return out_path.substr(0, extension) + "_chain" + std::to_string(chain) +
+           out_path.substr(extension);
+}
+
 /**
  * Sets the current logging level.
  */
@@ -258,15 +351,108 @@ int main(int argc, char *const *argv) {
         app.add_flag("--record-likelyhood", record_likelyhood,
                      "Additionally record the likelyhood of the sampled parameters.");
 
+    bool record_acceptance = false;
+    app.add_flag("--record-acceptance", record_acceptance,
+                 "Write each step's epsilon and delta acceptance rates and proposal scales to "
+                 "<output path>.acceptance.csv.");
+
     bool exact = false;
     CLI::Option *exact_flag =
         app.add_flag("--exact", exact, "Prevent approximations in calcualtion.");
 
     bool comparison = false;
-    app.add_flag("--comparison", comparison,
-                 "If both integration methods shosuld be used and compared.")
+    CLI::Option *comparison_flag =
+        app.add_flag("--comparison", comparison,
+                     "If both integration methods shosuld be used and compared.")
+            ->excludes(exact_flag);
+
+    double comparison_fraction = 1.0;
+    app.add_option("--comparison-fraction", comparison_fraction,
+                   "The fraction of sums to compare with --comparison.")
+        ->needs(comparison_flag);
+
+    std::string comparison_report_path;
+    app.add_option("--comparison-report", comparison_report_path,
+                   "Where to write the csv summary of --comparison. Defaults to the output path "
+                   "followed by .comparison.csv.")
+        ->needs(comparison_flag);
+
+    double approx_tolerance = 0.01;
+    app.add_option("--approx-tolerance", approx_tolerance,
+                   "The largest estimated error in each object's log likelyhood that using the "
+                   "normal approximation instead of the exact sum may add.")
+        ->excludes(exact_flag);
+
+    double truncation_tolerance = 0;
+    app.add_option("--truncation-tolerance", truncation_tolerance,
+                   "If positive, sum each object's likelyhood over n+ outwards from its most "
+                   "likely value, stopping once the terms left are provably at most this fraction "
+                   "of the sum. By default every term is evaluated.")
         ->excludes(exact_flag);
 
+    bool calibrate_dispatch = false;
+    CLI::Option *calibrate_dispatch_flag =
+        app.add_flag("--calibrate-dispatch", calibrate_dispatch,
+                     "Measure the cost of the exact and approximate methods on this machine at "
+                     "startup instead of using the built in estimates.");
+
+    std::vector<double> dispatch_model;
+    app.add_option("--dispatch-model", dispatch_model,
+                   "The exact ns per point, closed form ns, MVI3 ns and error constant to choose "
+                   "between the exact and approximate methods with, as recorded in the header of "
+                   "an earlier run. Replays that run's choices.")
+        ->expected(4)
+        ->excludes(calibrate_dispatch_flag);
+
+    int tries = 1;
+    app.add_option("--tries", tries,
+                   "The number of candidates each Metropolis-Hastings step for epsilon and delta "
+                   "evaluates, in parallel on as many threads (multiple-try Metropolis). Best "
+                   "combined with --threads 1, since the likelyhood's own threads are shared "
+                   "between candidates.")
+        ->check(CLI::PositiveNumber);
+
+    int adapt_iterations = 0;
+    app.add_option("--adapt-iterations", adapt_iterations,
+                   "The number of initial Gibbs iterations during which the epsilon and delta "
+                   "proposal scales adapt toward an acceptance rate of 0.44 and 0.234. By default "
+                   "both stay at 0.25.");
+
+    int chains = 1;
+    CLI::Option *chains_option =
+        app.add_option(
+               "--chains", chains,
+               "The number of independent chains to run on separate threads. With more than one, "
+               "chain k is written to the output path with _chain<k> before its extension, and "
+               "convergence diagnostics are logged after every batch.")
+            ->check(CLI::PositiveNumber);
+
+    double stop_r_hat = 0;
+    CLI::Option *stop_r_hat_option =
+        app.add_option("--stop-r-hat", stop_r_hat,
+                       "If positive, stop once the split R-hat of every sampled quantity is at "
+                       "most this, e.g. 1.01.")
+            ->needs(chains_option);
+
+    double stop_ess = 0;
+    app.add_option("--stop-ess", stop_ess,
+                   "With --stop-r-hat, also wait until the effective sample size of every "
+                   "sampled quantity is at least this.")
+        ->needs(stop_r_hat_option);
+
+    // Defaults to the clock; the header records it either way.
+    uint64_t seed = std::chrono::system_clock::now().time_since_epoch().count();
+    app.add_option("--seed", seed,
+                   "Seeds every random number in the run. The same seed, options and input "
+                   "reproduce the output exactly, whatever the number of threads, except that "
+                   "with --comparison-fraction below 1 on several threads which sums are "
+                   "compared (and so evaluated exactly) can vary. Defaults to the clock.");
+
+    int threads = 1;
+    app.add_option("--threads", threads,
+                   "The number of threads to evaluate the likelyhood on. Results do not depend "
+                   "on the number of threads.");
+
     bool use_smaller_alphas = false;
     CLI::Option *use_smaller_alphas_flag = app.add_flag("--use-smaller-alphas", use_smaller_alphas,
                                                         "Only consider alphas that are possible.")
@@ -281,36 +467,105 @@ int main(int argc, char *const *argv) {
 
     Options options;
     options.comparison = comparison;
+    options.comparison_fraction = comparison_fraction;
+    options.comparison_report_path =
+        comparison_report_path.empty() ? out_path + ".comparison.csv" : comparison_report_path;
     options.exact = exact;
     options.use_smaller_alphas = use_smaller_alphas;
     options.record_likelyhood = record_likelyhood;
+    options.approx_tolerance = approx_tolerance;
+    if (calibrate_dispatch) {
+        options.dispatch_model = ApproximationDispatcher::calibrate();
+    } else if (!dispatch_model.empty()) {
+        options.dispatch_model = {dispatch_model.at(0), dispatch_model.at(1), dispatch_model.at(2),
+                                  dispatch_model.at(3)};
+    }
+    // Full precision, so that --dispatch-model can replay it.
+    std::ostringstream dispatch_model_stream;
+    dispatch_model_stream.precision(17);
+    dispatch_model_stream << options.dispatch_model.exact_ns_per_point << " "
+                          << options.dispatch_model.closed_form_ns << " "
+                          << options.dispatch_model.mvi3_ns << " "
+                          << options.dispatch_model.error_constant;
+    BOOST_LOG_TRIVIAL(info) << "Approximation dispatch model (exact ns per point, closed form ns, "
+                               "MVI3 ns, error constant): "
+                            << dispatch_model_stream.str();
+    options.truncation_tolerance = truncation_tolerance;
+    options.threads = threads;
+    options.tries = tries;
+    options.adapt_iterations = adapt_iterations;
+    options.chains = chains;
+    options.stop_r_hat = stop_r_hat;
+    options.stop_ess = stop_ess;
+    options.seed = seed;
     options.fixed_alphas = alphas;
 
     auto data = read_category_counts_file(in_path);
 
-    std::ofstream out_file = setup_output(out_path);
+    std::ostringstream header;
+    header << "Comment: " << message << ", Input path: " << in_path
+           << ", Output path: " << out_path << ", Alpha path: " << alpha_path
+           << ", Iterations: " << std::to_string(iterations)
+           << ", Comparison: " << std::to_string(options.comparison)
+           << ", Comparison fraction: " << std::to_string(options.comparison_fraction)
+           << ", Exact: " << std::to_string(options.exact)
+           << ", Use smaller alphas: " << std::to_string(options.use_smaller_alphas)
+           << ", Record likelyhood: " << std::to_string(options.record_likelyhood)
+           << ", Approx tolerance: " << std::to_string(options.approx_tolerance)
+           << ", Truncation tolerance: " << std::to_string(options.truncation_tolerance)
+           << ", Threads: " << std::to_string(options.threads)
+           << ", Tries: " << std::to_string(options.tries)
+           << ", Adapt iterations: " << std::to_string(options.adapt_iterations)
+           << ", Chains: " << std::to_string(options.chains)
+           << ", Seed: " << std::to_string(options.seed)
+           << ", Dispatch model: " << dispatch_model_stream.str()
+           << ", Record acceptance: " << std::to_string(record_acceptance);
+
+    // Each chain gets its own file, so that every file has the single chain layout.
+    std::vector<std::ofstream> out_files;
+    for (int chain = 0; chain < options.chains; ++chain) {
+        if (options.chains > 1) {
+            out_files.push_back(setup_output(chain_output_path(out_path, chain)));
+            out_files.back() << header.str() << ", Chain: " << chain << std::endl;
+        } else {
+            out_files.push_back(setup_output(out_path));
+            out_files.back() << header.str() << std::endl;
+        }
+    }
 
-    out_file << "Comment: " << message << ", Input path: " << in_path
-             << ", Output path: " << out_path << ", Alpha path: " << alpha_path
-             << ", Iterations: " << std::to_string(iterations)
-             << ", Comparison: " << std::to_string(options.comparison)
-             << ", Exact: " << std::to_string(options.exact)
-             << ", Use smaller alphas: " << std::to_string(options.use_smaller_alphas)
-             << ", Record likelyhood: " << std::to_string(options.record_likelyhood) << std::endl;
+    // One row per chain and step, after a header row.
+    std::ofstream acceptance_file;
+    std::vector<int> acceptance_rows(options.chains, 0);
+    if (record_acceptance) {
+        acceptance_file = setup_output(out_path + ".acceptance.csv");
+        acceptance_file << "chain,iteration,epsilon_acceptance,epsilon_scale,delta_acceptance,"
+                           "delta_scale"
+                        << std::endl;
+    }
 
-    auto write_batch = [&out_file](std::vector<std::vector<alpha_t>> alpha_batch,
-                                   std::vector<double> epsilon_batch,
-                                   std::vector<delta_t> delta_batch,
-                                   std::vector<double> log_likelyhood_batch) {
+    auto write_batch = [&out_files, record_acceptance, &acceptance_file, &acceptance_rows](
+                           int chain, std::vector<std::vector<alpha_t>> alpha_batch,
+                           std::vector<double> epsilon_batch, std::vector<delta_t> delta_batch,
+                           std::vector<double> log_likelyhood_batch,
+                           std::vector<double> epsilon_acceptance_batch,
+                           std::vector<double> delta_acceptance_batch,
+                           std::vector<double> epsilon_scale_batch,
+                           std::vector<double> delta_scale_batch) {
+        std::ofstream &out_file = out_files.at(chain);
         for (int i = 0; i < alpha_batch.size(); ++i) {
+            out_file << vector_of_vector_to_string<>(alpha_batch.at(i)) << ","
+                     << epsilon_batch.at(i) << "," << vector_to_string<>(delta_batch.at(i));
             if (!log_likelyhood_batch.empty()) {
-                out_file << vector_of_vector_to_string<>(alpha_batch.at(i)) << ","
-                         << epsilon_batch.at(i) << "," << vector_to_string<>(delta_batch.at(i))
-                         << "," << log_likelyhood_batch.at(i) << std::endl;
-            } else {
-                out_file << vector_of_vector_to_string<>(alpha_batch.at(i)) << ","
-                         << epsilon_batch.at(i) << "," << vector_to_string<>(delta_batch.at(i))
-                         << std::endl;
+                out_file << "," << log_likelyhood_batch.at(i);
+            }
+            out_file << std::endl;
+
+            if (record_acceptance) {
+                acceptance_file << chain << "," << acceptance_rows.at(chain)++ << ","
+                                << epsilon_acceptance_batch.at(i) << ","
+                                << epsilon_scale_batch.at(i) << ","
+                                << delta_acceptance_batch.at(i) << ","
+                                << delta_scale_batch.at(i) << std::endl;
             }
         }
     };
@@ -319,5 +574,10 @@ int main(int argc, char *const *argv) {
 
     BOOST_LOG_TRIVIAL(info) << "Inference complete.";
 
-    out_file.close();
+    for (std::ofstream &out_file : out_files) {
+        out_file.close();
+    }
+    if (record_acceptance) {
+        acceptance_file.close();
+    }
 }
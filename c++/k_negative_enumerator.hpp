@@ -0,0 +1,178 @@
+#ifndef K_NEGATIVE_ENUMERATOR_HPP
+#define K_NEGATIVE_ENUMERATOR_HPP
+
+/**
+ * Contains the enumerator over the possible noise counts k^- of an object for any number of
+ * categories.
+ */
+
+#include "types.hpp"
+
+#include <assert.h>
+#include <algorithm>
+#include <boost/log/trivial.hpp>
+#include <type_traits>
+#include <utility>
+
+namespace FilterModel {
+
+// The largest number of categories the compile time specialised kernels are instantiated for.
+const int MAX_CATEGORIES = 8;
+
+/**
+ * Enumerates every k^- consistent with n^+, n^-, alpha and the object counts k for N categories.
+ *
+ * A valid k^- has sum_i k_i^- = n^-, k_i - n^+ <= k_i^- <= k_i, and k_i^- = k_i whenever alpha_i
+ * is false. The bounds on each component are tightened with the bounds of the components after it,
+ * so every prefix the loops visit leads to at least one valid k^-.
+ *
+ * N is a template argument so that the loops are nested at compile time and unrolled just like a
+ * hand written loop for a fixed number of categories. Use dispatch_categories to pick N at
+ * runtime.
+ */
+template <int N>
+class KNegativeEnumerator {
+   public:
+    /**
+     * Calls f(k_negative, start, end) once for every non-empty row. In a row k_negative[0] to
+     * k_negative[N - 3] are fixed, k_negative[N - 2] takes every value in [start, end], and
+     * k_negative[N - 1] is n^- minus the other components. Requires N >= 2.
+     */
+    template <class F>
+    static void rows(F &&f, int n_positive, int n_negative, const alpha_t &alpha,
+                     const category_counts_t &object_counts) {
+        static_assert(N >= 2, "Rows need at least two categories.");
+        Bounds bounds;
+        if (!make_bounds(bounds, n_positive, alpha, object_counts)) {
+            return;
+        }
+        int k_negative[N];
+        visit_rows(f, bounds, k_negative, n_negative, std::integral_constant<int, 0>());
+    }
+
+    /**
+     * Calls f(k_negative) with a pointer to the N components of every valid k^-, in
+     * lexicographic order.
+     */
+    template <class F>
+    static void points(F &&f, int n_positive, int n_negative, const alpha_t &alpha,
+                       const category_counts_t &object_counts) {
+        visit_points(f, n_positive, n_negative, alpha, object_counts,
+                     std::integral_constant<bool, (N >= 2)>());
+    }
+
+   private:
+    struct Bounds {
+        int lower[N];
+        int upper[N];
+        // Sums of lower and upper from index i to the end. Index N is 0.
+        int lower_suffix[N + 1];
+        int upper_suffix[N + 1];
+    };
+
+    static bool make_bounds(Bounds &bounds, int n_positive, const alpha_t &alpha,
+                            const category_counts_t &object_counts) {
+        assert(alpha.size() == N && object_counts.size() == N);
+        bounds.lower_suffix[N] = 0;
+        bounds.upper_suffix[N] = 0;
+        for (int i = N - 1; i >= 0; --i) {
+            bounds.upper[i] = object_counts[i];
+            bounds.lower[i] =
+                alpha[i] ? std::max(object_counts[i] - n_positive, 0) : object_counts[i];
+            if (bounds.lower[i] > bounds.upper[i]) {
+                return false;
+            }
+            bounds.lower_suffix[i] = bounds.lower_suffix[i + 1] + bounds.lower[i];
+            bounds.upper_suffix[i] = bounds.upper_suffix[i + 1] + bounds.upper[i];
+        }
+        return true;
+    }
+
+    template <class F, int D>
+    static void visit_rows(F &f, const Bounds &bounds, int *k_negative, int remaining,
+                           std::integral_constant<int, D>) {
+        int start = std::max(bounds.lower[D], remaining - bounds.upper_suffix[D + 1]);
+        int end = std::min(bounds.upper[D], remaining - bounds.lower_suffix[D + 1]);
+        for (int k = start; k <= end; ++k) {
+            k_negative[D] = k;
+            visit_rows(f, bounds, k_negative, remaining - k, std::integral_constant<int, D + 1>());
+        }
+    }
+
+    template <class F>
+    static void visit_rows(F &f, const Bounds &bounds, int *k_negative, int remaining,
+                           std::integral_constant<int, N - 2>) {
+        int start = std::max(bounds.lower[N - 2], remaining - bounds.upper[N - 1]);
+        int end = std::min(bounds.upper[N - 2], remaining - bounds.lower[N - 1]);
+        if (start <= end) {
+            f(const_cast<const int *>(k_negative), start, end);
+        }
+    }
+
+    template <class F>
+    static void visit_points(F &f, int n_positive, int n_negative, const alpha_t &alpha,
+                             const category_counts_t &object_counts, std::true_type) {
+        int k_negative[N];
+        rows(
+            [&f, &k_negative, n_negative](const int *prefix, int start, int end) {
+                int prefix_sum = 0;
+                for (int i = 0; i < N - 2; ++i) {
+                    k_negative[i] = prefix[i];
+                    prefix_sum += prefix[i];
+                }
+                for (int k = start; k <= end; ++k) {
+                    k_negative[N - 2] = k;
+                    k_negative[N - 1] = n_negative - prefix_sum - k;
+                    f(const_cast<const int *>(k_negative));
+                }
+            },
+            n_positive, n_negative, alpha, object_counts);
+    }
+
+    template <class F>
+    static void visit_points(F &f, int n_positive, int n_negative, const alpha_t &alpha,
+                             const category_counts_t &object_counts, std::false_type) {
+        Bounds bounds;
+        if (make_bounds(bounds, n_positive, alpha, object_counts) &&
+            bounds.lower[0] <= n_negative && n_negative <= bounds.upper[0]) {
+            int k_negative[1] = {n_negative};
+            f(const_cast<const int *>(k_negative));
+        }
+    }
+};
+
+/**
+ * Returns Kernel<n_categories>::run(args...), choosing the compile time specialisation from the
+ * runtime number of categories.
+ */
+template <template <int> class Kernel, class... Args>
+auto dispatch_categories(int n_categories, Args &&... args)
+    -> decltype(Kernel<1>::run(std::forward<Args>(args)...)) {
+    switch (n_categories) {
+        case 1:
+            return Kernel<1>::run(std::forward<Args>(args)...);
+        case 2:
+            return Kernel<2>::run(std::forward<Args>(args)...);
+        case 3:
+            return Kernel<3>::run(std::forward<Args>(args)...);
+        case 4:
+            return Kernel<4>::run(std::forward<Args>(args)...);
+        case 5:
+            return Kernel<5>::run(std::forward<Args>(args)...);
+        case 6:
+            return Kernel<6>::run(std::forward<Args>(args)...);
+        case 7:
+            return Kernel<7>::run(std::forward<Args>(args)...);
+        case 8:
+            return Kernel<MAX_CATEGORIES>::run(std::forward<Args>(args)...);
+        default:
+            BOOST_LOG_TRIVIAL(fatal) << "Between 1 and " << MAX_CATEGORIES
+                                     << " categories are supported, got " << n_categories << ".";
+            assert(false);
+            return Kernel<1>::run(std::forward<Args>(args)...);
+    }
+}
+
+}  // namespace FilterModel
+
+#endif
@@ -0,0 +1,57 @@
+#include "k_negative_sampler.hpp"
+
+#include <algorithm>
+
+namespace FilterModel {
+
+KNegativeSliceSampler::KNegativeSliceSampler(double n_negative,
+                                             const std::vector<double> &capacities)
+    : n_negative(n_negative), capacities(capacities), remaining_capacities(capacities.size()) {
+    double sum = 0.0;
+    for (int i = capacities.size() - 1; i >= 0; --i) {
+        remaining_capacities[i] = sum;
+        sum += capacities[i];
+    }
+}
+
+void KNegativeSliceSampler::operator()(const std::vector<double> &u, int n_points,
+                                       std::vector<double> &points,
+                                       std::vector<double> &weights) const {
+    const int d = dimensions();
+    for (int j = 0; j < n_points; ++j) {
+        const double *u_j = &u[j * d];
+        double *point = &points[j * d];
+        double remaining = n_negative;
+        double weight = 1.0;
+        for (int i = 0; i < d; ++i) {
+            // Leave between 0 and the capacity of the components after this one. An empty range
+            // only happens for the first component, when the whole slice is empty.
+            double low = std::max(0.0, remaining - remaining_capacities[i]);
+            double high = std::min(capacities[i], remaining);
+            double width = std::max(high - low, 0.0);
+            point[i] = low + u_j[i] * width;
+            weight *= width;
+            remaining -= point[i];
+        }
+        // The bounds keep the last component, remaining, in [0, capacities[d]].
+        weights[j] = weight;
+    }
+}
+
+double KNegativeSliceSampler::density(const double *point) const {
+    const int d = dimensions();
+    double remaining = n_negative;
+    double weight = 1.0;
+    for (int i = 0; i < d; ++i) {
+        double low = std::max(0.0, remaining - remaining_capacities[i]);
+        double high = std::min(capacities[i], remaining);
+        if (!(low <= point[i] && point[i] <= high && low < high)) {
+            return 0.0;
+        }
+        weight *= high - low;
+        remaining -= point[i];
+    }
+    return 1.0 / weight;
+}
+
+}  // namespace FilterModel
@@ -0,0 +1,58 @@
+#ifndef K_NEGATIVE_SAMPLER_HPP
+#define K_NEGATIVE_SAMPLER_HPP
+
+/**
+ * Contains the block sampler integrate_qmc_blocks uses to integrate over continuous k^-.
+ */
+
+#include "types.hpp"
+
+#include <vector>
+
+namespace FilterModel {
+
+/**
+ * Maps the unit cube onto the slice of continuous k^- with 0 <= k_i^- <= k_i for every category
+ * and sum_i k_i^- = n^-, parametrised by all but the last component.
+ *
+ * The components are drawn in turn, each uniformly between the bounds left by the components
+ * before it and the capacities of those after it, so every point is in the slice and none are
+ * rejected. The map is not uniform: the weight of a point is the product of the widths it was
+ * drawn from, i.e. the inverse of its density, so the sum of weight * f over the points
+ * estimates the integral of f over the slice.
+ */
+class KNegativeSliceSampler {
+   public:
+    /**
+     * n_negative: The sum of the components.
+     * capacities: The upper bound k_i of every component, including the last.
+     */
+    KNegativeSliceSampler(double n_negative, const std::vector<double> &capacities);
+
+    int dimensions() const { return capacities.size() - 1; }
+
+    /**
+     * Maps the n_points points in u onto the slice, writing the points to points and their
+     * weights to weights. Point j is stored in u[j * dimensions(), (j + 1) * dimensions()) and
+     * the same range of points. If the slice is empty every weight is zero.
+     *
+     * A callable with this signature is a block sampler for integrate_qmc_blocks.
+     */
+    void operator()(const std::vector<double> &u, int n_points, std::vector<double> &points,
+                    std::vector<double> &weights) const;
+
+    /**
+     * Returns the density the sampler draws point from, the inverse of its weight, or zero if
+     * point, of dimensions() components, is not in the slice.
+     */
+    double density(const double *point) const;
+
+   private:
+    double n_negative;
+    std::vector<double> capacities;
+    // remaining_capacities[i] is the sum of the capacities after component i.
+    std::vector<double> remaining_capacities;
+};
+}  // namespace FilterModel
+
+#endif
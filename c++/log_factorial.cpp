@@ -0,0 +1,43 @@
+#include "log_factorial.hpp"
+
+#include <cmath>
+
+namespace FilterModel {
+
+std::unique_ptr<double[]> LogFactorial::chunks[LogFactorial::MAX_CHUNKS];
+std::atomic<int> LogFactorial::size(0);
+std::mutex LogFactorial::grow_mutex;
+
+void LogFactorial::reserve(int n) {
+    if (n < table_size()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(grow_mutex);
+
+    int old_size = size.load(std::memory_order_relaxed);
+    long new_size = std::min<long>(long(n) + 1, long(MAX_CHUNKS) * CHUNK_SIZE);
+    for (long i = old_size; i < new_size; ++i) {
+        std::unique_ptr<double[]> &chunk = chunks[i >> CHUNK_SHIFT];
+        if (!chunk) {
+            chunk.reset(new double[CHUNK_SIZE]);
+        }
+        // lgamma rather than a running sum of logs so that table values are bit for bit the
+        // values the kernels computed before the table existed.
+        chunk[i & CHUNK_MASK] = std::lgamma(i + 1.0);
+    }
+
+    // Publish the new entries only after they are written.
+    size.store(int(new_size), std::memory_order_release);
+}
+
+double LogFactorial::log_factorial_slow(int n) {
+    if (n < 0 || n >= MAX_CHUNKS * CHUNK_SIZE) {
+        return std::lgamma(n + 1.0);
+    }
+    // Grow geometrically so that a run of increasing counts doesn't regrow on every call.
+    reserve(std::max(n, 2 * table_size()));
+    return chunks[n >> CHUNK_SHIFT][n & CHUNK_MASK];
+}
+
+}  // namespace FilterModel
@@ -0,0 +1,59 @@
+#ifndef LOG_FACTORIAL_HPP
+#define LOG_FACTORIAL_HPP
+
+/**
+ * Contains a process wide lookup table of log(n!) shared by all of the likelihood kernels.
+ */
+
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <mutex>
+
+namespace FilterModel {
+class LogFactorial {
+   public:
+    /**
+     * Returns log(n!), i.e. lgamma(n + 1).
+     *
+     * Values inside the table are a plain array read. Values past the end of the table grow the
+     * table to cover n. Negative n fall back to std::lgamma so that edge cases (e.g. lgamma(0) =
+     * inf) behave exactly as before.
+     */
+    static inline double log_factorial(int n) {
+        if (n >= 0 && n < size.load(std::memory_order_acquire)) {
+            return chunks[n >> CHUNK_SHIFT][n & CHUNK_MASK];
+        }
+        return log_factorial_slow(n);
+    }
+
+    /**
+     * Grows the table so that log_factorial(i) is a table lookup for every 0 <= i <= n.
+     *
+     * Growing is guarded by a mutex and only ever appends, so threads may read the table while
+     * another thread grows it. Existing entries are never modified.
+     */
+    static void reserve(int n);
+
+    /**
+     * Returns the number of entries currently in the table.
+     */
+    static int table_size() { return size.load(std::memory_order_acquire); }
+
+   private:
+    // Entries are stored in fixed size chunks so that growing never moves existing entries.
+    static const int CHUNK_SHIFT = 16;
+    static const int CHUNK_SIZE = 1 << CHUNK_SHIFT;
+    static const int CHUNK_MASK = CHUNK_SIZE - 1;
+    // 2^12 chunks of 2^16 entries each covers counts up to ~2.7e8.
+    static const int MAX_CHUNKS = 1 << 12;
+
+    static std::unique_ptr<double[]> chunks[MAX_CHUNKS];
+    static std::atomic<int> size;
+    static std::mutex grow_mutex;
+
+    static double log_factorial_slow(int n);
+};
+}  // namespace FilterModel
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef LOG_SUM_EXP_HPP
+#define LOG_SUM_EXP_HPP
+
+/**
+ * Contains a streaming accumulator for sums of numbers given in log space.
+ */
+
+#include <cmath>
+
+namespace FilterModel {
+
+/**
+ * Accumulates log(sum_i exp(x_i)) one x_i at a time without storing the terms.
+ *
+ * The running sum is kept relative to the largest term seen so far, so terms whose exponentials
+ * would underflow (e.g. log probabilities of -5000) still give a finite result, and no term can
+ * overflow.
+ *
+ * Template arguments:
+ *   compensated - if true, the relative sum uses Neumaier compensated summation. This costs a few
+ *     extra flops per term and gives roughly the accuracy of stable_sum without its allocations.
+ *
+ * Accumulators can be merged, so partial sums from different threads can be reduced into one.
+ */
+template <bool compensated = false>
+class LogSumExp {
+   public:
+    /**
+     * Adds exp(log_x) to the sum.
+     */
+    inline void add(double log_x) {
+        if (log_x == -INFINITY) {
+            return;
+        }
+        if (log_x > max) {
+            rescale(max - log_x);
+            max = log_x;
+            add_relative(1.0);
+        } else {
+            add_relative(std::exp(log_x - max));
+        }
+    }
+
+    /**
+     * Adds another accumulator's terms to this one.
+     */
+    inline void merge(const LogSumExp &other) {
+        if (other.max == -INFINITY) {
+            return;
+        }
+        if (other.max > max) {
+            rescale(max - other.max);
+            max = other.max;
+            add_relative(other.sum);
+            add_relative(other.compensation);
+        } else {
+            double scale = std::exp(other.max - max);
+            add_relative(other.sum * scale);
+            add_relative(other.compensation * scale);
+        }
+    }
+
+    /**
+     * Returns log of the sum of the exponentials of every term added so far, or -INFINITY if
+     * nothing has been added.
+     */
+    inline double result() const {
+        if (max == -INFINITY) {
+            return -INFINITY;
+        }
+        return max + std::log(sum + compensation);
+    }
+
+   private:
+    // Largest term seen so far. Every other quantity is relative to exp(max).
+    double max = -INFINITY;
+    double sum = 0.0;
+    // Running error of sum. Always 0 when not compensated.
+    double compensation = 0.0;
+
+    inline void rescale(double log_scale) {
+        double scale = std::exp(log_scale);
+        sum *= scale;
+        compensation *= scale;
+    }
+
+    inline void add_relative(double x) {
+        if (compensated) {
+            double t = sum + x;
+            if (std::abs(sum) >= std::abs(x)) {
+                compensation += (sum - t) + x;
+            } else {
+                compensation += (x - t) + sum;
+            }
+            sum = t;
+        } else {
+            sum += x;
+        }
+    }
+};
+}  // namespace FilterModel
+
+#endif
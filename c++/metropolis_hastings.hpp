@@ -5,13 +5,80 @@
  * Preforms generic metropolis hasting sampling.
  */
 
+#include "log_sum_exp.hpp"
+#include "thread_pool.hpp"
 #include "utils.hpp"
 
+#include <algorithm>
+#include <cassert>
+#include <cmath>
 #include <functional>
 #include <random>
 #include <vector>
 
 namespace FilterModel {
+
+/**
+ * The scale of a Metropolis-Hastings proposal, with counts of the proposals made and accepted.
+ *
+ * While adapting, every step moves log(scale) by (acceptance probability - target) / t^0.6 for
+ * the t-th adapting step (Robbins-Monro), so the scale settles where about target of the
+ * proposals are accepted. Adaptation should stop after burn in: a chain whose proposal keeps
+ * changing need not converge to the target distribution.
+ */
+class ProposalScale {
+   public:
+    /**
+     * target_acceptance: 0.44 is optimal for one dimensional random walks, falling to 0.234 in
+     *   many dimensions (Roberts, Gelman and Gilks 1997).
+     */
+    explicit ProposalScale(double scale, double target_acceptance = 0.234)
+        : log_scale(std::log(scale)), target_acceptance(target_acceptance) {}
+
+    double get() const { return std::exp(log_scale); }
+
+    void set_adapting(bool adapting) { this->adapting = adapting; }
+    bool is_adapting() const { return adapting; }
+
+    /**
+     * Records one proposal that was accepted with the given probability.
+     */
+    void record(double acceptance_probability, bool accepted) {
+        ++proposals;
+        this->accepted += accepted;
+        if (adapting) {
+            // Keeps one unlucky run of proposals from sending the scale somewhere it can't
+            // return from.
+            const double min_log_scale = -14;
+            const double max_log_scale = 2;
+            ++adapting_steps;
+            log_scale +=
+                (acceptance_probability - target_acceptance) / std::pow(adapting_steps, 0.6);
+            log_scale = std::max(std::min(log_scale, max_log_scale), min_log_scale);
+        }
+    }
+
+    long get_proposals() const { return proposals; }
+    long get_accepted() const { return accepted; }
+
+   private:
+    double log_scale;
+    double target_acceptance;
+    bool adapting = false;
+    long adapting_steps = 0;
+    long proposals = 0;
+    long accepted = 0;
+};
+
+/**
+ * A state of a Metropolis-Hastings chain: its value and the log of the pdf at it.
+ */
+template <class T>
+struct MetropolisHastingsState {
+    T value;
+    double log_pdf;
+};
+
 class MetropolisHastingsSampler {
    public:
     /**
@@ -29,37 +96,190 @@ class MetropolisHastingsSampler {
      *     returns a new element of type T given the previous value.
      *  gen - A random number generator.
      *  *values - a pointer to a vector. If not null, all of the sampled values are stored here.
+     *  *scale - if not null, every step is recorded in it (and adapts it, if it is adapting). The
+     *     conditional sampler should read its scale from it.
      */
     template <class T, class generator>
     static T sample(int iterations, const std::function<double(T value)> log_pdf,
                     const std::function<T(generator &gen)> uniform_sampler,
                     const std::function<T(T center, generator &gen)> conditional_sampler,
-                    generator &gen, std::vector<T> *values = nullptr) {
+                    generator &gen, std::vector<T> *values = nullptr,
+                    ProposalScale *scale = nullptr) {
+        T start = uniform_sampler(gen);
+        return sample_from<T, generator>(iterations, {start, NAN}, log_pdf, conditional_sampler,
+                                         gen, values, scale)
+            .value;
+    }
+
+    /**
+     * Like sample, but starts from the given state instead of a uniform draw. Warm starting from
+     * the previous value of a Gibbs step skips the walk back from a random point.
+     *
+     * start.log_pdf is evaluated if it is NaN. Pass it when it is already known, such as when
+     * the target has not changed since the state was sampled, to save a log_pdf call.
+     *
+     * Returns the last state, with its log pdf.
+     */
+    template <class T, class generator>
+    static MetropolisHastingsState<T> sample_from(
+        int iterations, MetropolisHastingsState<T> start,
+        const std::function<double(T value)> log_pdf,
+        const std::function<T(T center, generator &gen)> conditional_sampler, generator &gen,
+        std::vector<T> *values = nullptr, ProposalScale *scale = nullptr) {
         std::uniform_real_distribution<> prior_distribution(0.0, 1.0);
-        T value = uniform_sampler(gen);
+        T value = start.value;
         if (values != nullptr) {
             values->push_back(value);
         }
 
-        double p_value = log_pdf(value);
+        double p_value = std::isnan(start.log_pdf) ? log_pdf(value) : start.log_pdf;
 
         for (int i = 0; i < iterations; ++i) {
             T candidate_value = conditional_sampler(value, gen);
             double p_candidate_value = log_pdf(candidate_value);
+            double acceptance_probability = 0.0;
+            bool accepted = false;
             if (p_candidate_value != -INFINITY) {
                 double p_accept = std::min(0.0, p_candidate_value - p_value);
-                if (prior_distribution(gen) < std::exp(p_accept)) {
+                acceptance_probability = std::exp(p_accept);
+                if (prior_distribution(gen) < acceptance_probability) {
+                    value = candidate_value;
+                    p_value = p_candidate_value;
+                    accepted = true;
+                }
+            }
+            if (scale != nullptr) {
+                scale->record(acceptance_probability, accepted);
+            }
+
+            if (values != nullptr) {
+                values->push_back(value);
+            }
+        }
+
+        return {value, p_value};
+    }
+
+    /**
+     * Multiple-try Metropolis (Liu, Liang and Wong 2000), a drop-in alternative to sample that
+     * evaluates tries candidates per iteration instead of one.
+     *
+     * Each iteration draws tries candidates around the current value and picks one with
+     * probability proportional to its pdf. It then draws tries - 1 reference points around the
+     * picked candidate, adds the current value to them, and accepts with probability
+     * min(1, sum of candidate pdfs / sum of reference pdfs). Like sample, this assumes the
+     * conditional sampler is symmetric. With tries = 1 it is the same chain as sample.
+     *
+     * All random numbers are drawn on the calling thread and only log_pdf runs in parallel, so the
+     * chain does not depend on the number of threads.
+     *
+     * Arguments are those of sample, and:
+     *  tries - the number of candidates per iteration, at least 1.
+     *  thread_pool - if not null, the candidates, then the reference points, are evaluated in
+     *     parallel on it. log_pdf must then be safe to call from several threads, and must not
+     *     itself use the same pool.
+     */
+    template <class T, class generator>
+    static T sample_multiple_try(
+        int iterations, int tries, const std::function<double(T value)> log_pdf,
+        const std::function<T(generator &gen)> uniform_sampler,
+        const std::function<T(T center, generator &gen)> conditional_sampler, generator &gen,
+        ThreadPool *thread_pool = nullptr, std::vector<T> *values = nullptr,
+        ProposalScale *scale = nullptr) {
+        T start = uniform_sampler(gen);
+        return sample_multiple_try_from<T, generator>(iterations, tries, {start, NAN}, log_pdf,
+                                                      conditional_sampler, gen, thread_pool,
+                                                      values, scale)
+            .value;
+    }
+
+    /**
+     * sample_multiple_try starting from the given state, as in sample_from.
+     */
+    template <class T, class generator>
+    static MetropolisHastingsState<T> sample_multiple_try_from(
+        int iterations, int tries, MetropolisHastingsState<T> start,
+        const std::function<double(T value)> log_pdf,
+        const std::function<T(T center, generator &gen)> conditional_sampler, generator &gen,
+        ThreadPool *thread_pool = nullptr, std::vector<T> *values = nullptr,
+        ProposalScale *scale = nullptr) {
+        assert(tries >= 1);
+        std::uniform_real_distribution<> prior_distribution(0.0, 1.0);
+        T value = start.value;
+        if (values != nullptr) {
+            values->push_back(value);
+        }
+
+        double p_value = std::isnan(start.log_pdf) ? log_pdf(value) : start.log_pdf;
+
+        std::vector<T> points(tries);
+        std::vector<double> log_p(tries);
+        // Evaluates log_pdf on points[0, n).
+        auto evaluate = [&](int n) {
+            std::function<void(int)> f = [&](int i) { log_p[i] = log_pdf(points[i]); };
+            if (thread_pool) {
+                thread_pool->parallel_for(n, f);
+            } else {
+                for (int i = 0; i < n; ++i) {
+                    f(i);
+                }
+            }
+        };
+
+        for (int i = 0; i < iterations; ++i) {
+            for (T &point : points) {
+                point = conditional_sampler(value, gen);
+            }
+            evaluate(tries);
+
+            LogSumExp<> log_candidate_total;
+            for (double log_p_candidate : log_p) {
+                log_candidate_total.add(log_p_candidate);
+            }
+            double acceptance_probability = 0.0;
+            bool accepted = false;
+            if (log_candidate_total.result() != -INFINITY) {
+                // Pick a candidate with probability proportional to its pdf.
+                std::vector<double> weights(tries);
+                for (int j = 0; j < tries; ++j) {
+                    weights[j] = std::exp(log_p[j] - log_candidate_total.result());
+                }
+                int picked = 0;
+                if (tries > 1) {
+                    picked = std::discrete_distribution<int>(weights.begin(), weights.end())(gen);
+                }
+                T candidate_value = points[picked];
+                double p_candidate_value = log_p[picked];
+
+                for (int j = 0; j < tries - 1; ++j) {
+                    points[j] = conditional_sampler(candidate_value, gen);
+                }
+                evaluate(tries - 1);
+                LogSumExp<> log_reference_total;
+                for (int j = 0; j < tries - 1; ++j) {
+                    log_reference_total.add(log_p[j]);
+                }
+                log_reference_total.add(p_value);
+
+                double p_accept =
+                    std::min(0.0, log_candidate_total.result() - log_reference_total.result());
+                acceptance_probability = std::exp(p_accept);
+                if (prior_distribution(gen) < acceptance_probability) {
                     value = candidate_value;
                     p_value = p_candidate_value;
+                    accepted = true;
                 }
             }
+            if (scale != nullptr) {
+                scale->record(acceptance_probability, accepted);
+            }
 
             if (values != nullptr) {
                 values->push_back(value);
             }
         }
 
-        return value;
+        return {value, p_value};
     }
 };
 }  // namespace FilterModel
@@ -1,91 +1,223 @@
 #include "model_distribution.hpp"
 
+#include "gaussian_polytope.hpp"
+#include "k_negative_sampler.hpp"
+#include "log_factorial.hpp"
+#include "log_sum_exp.hpp"
 #include "monte_carlo_integration.hpp"
 #include "multinomial.hpp"
+#include "multinomial_batch.hpp"
 #include "multivariate_guassian.hpp"
 #include "mvi3/mvi3.hpp"
+#include "philox.hpp"
 #include "types.hpp"
 #include "utils.hpp"
 
 #include <algorithm>
 #include <boost/log/trivial.hpp>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <map>
 #include <numeric>
 #include <vector>
 
 namespace FilterModel {
 ModelDistribution::ModelDistribution(const std::vector<category_counts_t> &data,
-                                     std::default_random_engine &generator, const Options &options)
-    : data(data), generator(generator), options(options){};
+                                     const Options &options)
+    : options(options),
+      dispatcher(options.exact ? 0.0 : options.approx_tolerance, options.dispatch_model),
+      term_counts(std::make_shared<TermCounts>()),
+      n_objects(data.size()) {
+    if (options.threads > 1) {
+        thread_pool = std::make_shared<ThreadPool>(options.threads);
+    }
+    if (options.comparison) {
+        comparison_report = std::make_shared<ComparisonReport>(options.comparison_fraction);
+    }
+
+    // Many objects (especially in downsampled data) share the exact same counts, so only the
+    // unique count vectors are evaluated and the results are scattered back per object.
+    std::map<category_counts_t, int> unique_indices;
+    for (const category_counts_t &object_counts : data) {
+        auto inserted = unique_indices.insert(std::make_pair(object_counts, unique_data.size()));
+        if (inserted.second) {
+            unique_data.push_back(object_counts);
+        }
+        unique_index_per_object.push_back(inserted.first->second);
+    }
+    if (unique_data.size() < n_objects) {
+        BOOST_LOG_TRIVIAL(info) << "Deduplicated " << n_objects << " objects into "
+                                << unique_data.size() << " unique count vectors.";
+    }
+
+    // Build the log factorial table up front so that the likelihood kernels never grow it. The
+    // largest factorial used is n + sum(alpha) - 1 in
+    // calculate_log_p_k_positive_given_alpha_n_positive.
+    int max_n = 0;
+    for (const category_counts_t &object_counts : unique_data) {
+        int n = std::accumulate(object_counts.begin(), object_counts.end(), 0);
+        max_n = std::max(max_n, n + int(object_counts.size()));
+    }
+    LogFactorial::reserve(max_n);
+};
 
 std::vector<std::vector<double>> ModelDistribution::distribution(
     const std::vector<std::vector<alpha_t>> &alphas_per_object, double epsilon,
     const delta_t &delta) const {
     // See function definition for description.
-    std::vector<std::vector<double>> log_alpha_likelyhoods_per_object(data.size(),
-                                                                      std::vector<double>());
-    for (int obs_index = 0; obs_index < data.size(); ++obs_index) {
-        const category_counts_t &object_counts = data.at(obs_index);
-        const std::vector<alpha_t> &alphas = alphas_per_object.at(obs_index);
-
-        int n = std::accumulate(object_counts.begin(), object_counts.end(), 0);
-        std::vector<double> p = {1 - epsilon, epsilon};
-        Multinomial n_positive_distribution(n, p);
 
-        for (int alpha_index = 0; alpha_index < alphas.size(); ++alpha_index) {
-            const alpha_t &alpha = alphas.at(alpha_index);
-
-            // n^+ goes from 0 to the sum of k_i for which alpha_i is true
-            // When alpha_i is false, then all of the k_i corresponding must be noise reads.
-            const category_counts_t filtered_object_counts = filter_by_alpha(alpha, object_counts);
-            const int max_n_positive =
-                std::accumulate(filtered_object_counts.begin(), filtered_object_counts.end(), 0);
-
-            std::vector<double> log_p_k_n_positive_given_all_terms;
-            // n_positive is the number of observations not made by the error process.
-            for (int n_positive = 0; n_positive <= max_n_positive; ++n_positive) {
-                // n_negative is the number of observations made by the error process.
-                int n_negative = n - n_positive;
-                double log_p_n_plus_given_n_epsilon =
-                    n_positive_distribution.log_pdf(std::vector<int>({n_positive, n_negative}));
+    // Objects with the same counts and alpha have the same likelyhood, so each (unique counts,
+    // alpha) pair is only evaluated once. Collect the distinct pairs first, in object order, so
+    // that they can be evaluated independently.
+    std::vector<std::map<alpha_t, int>> task_index_per_unique(unique_data.size());
+    std::vector<std::pair<int, alpha_t>> tasks;
+    for (int obs_index = 0; obs_index < n_objects; ++obs_index) {
+        int unique_index = unique_index_per_object.at(obs_index);
+        for (const alpha_t &alpha : alphas_per_object.at(obs_index)) {
+            if (task_index_per_unique.at(unique_index)
+                    .insert(std::make_pair(alpha, tasks.size()))
+                    .second) {
+                tasks.push_back(std::make_pair(unique_index, alpha));
+            }
+        }
+    }
 
-                double log_p_k_positive_given_alpha_n_positive =
-                    calculate_log_p_k_positive_given_alpha_n_positive(n_positive, alpha);
+    // Each task only writes its own slot, so the results don't depend on the number of threads.
+    std::vector<double> task_log_likelyhoods(tasks.size());
+    std::function<void(int)> evaluate_task = [this, &tasks, &task_log_likelyhoods, epsilon,
+                                              &delta](int task_index) {
+        const std::pair<int, alpha_t> &task = tasks.at(task_index);
+        task_log_likelyhoods.at(task_index) =
+            log_likelyhood(unique_data.at(task.first), task.second, epsilon, delta);
+    };
+    if (thread_pool) {
+        thread_pool->parallel_for(tasks.size(), evaluate_task);
+    } else {
+        for (int task_index = 0; task_index < tasks.size(); ++task_index) {
+            evaluate_task(task_index);
+        }
+    }
 
-                double log_sum_over_k_negative = calculate_log_sum_over_k_negative(
-                    n_positive, n_negative, alpha, delta, object_counts);
+    std::vector<std::vector<double>> log_alpha_likelyhoods_per_object(n_objects,
+                                                                      std::vector<double>());
+    for (int obs_index = 0; obs_index < n_objects; ++obs_index) {
+        const std::map<alpha_t, int> &task_indices =
+            task_index_per_unique.at(unique_index_per_object.at(obs_index));
+        for (const alpha_t &alpha : alphas_per_object.at(obs_index)) {
+            log_alpha_likelyhoods_per_object.at(obs_index).push_back(
+                task_log_likelyhoods.at(task_indices.at(alpha)));
+        }
+    }
+    return log_alpha_likelyhoods_per_object;
+}
 
-                double log_p_k_n_positive_given_all = log_p_n_plus_given_n_epsilon +
-                                                      log_p_k_positive_given_alpha_n_positive +
-                                                      log_sum_over_k_negative;
+double ModelDistribution::log_likelyhood(const category_counts_t &object_counts,
+                                         const alpha_t &alpha, double epsilon,
+                                         const delta_t &delta) const {
+    int n = std::accumulate(object_counts.begin(), object_counts.end(), 0);
+    std::vector<double> p = {1 - epsilon, epsilon};
+    Multinomial n_positive_distribution(n, p);
+
+    // n^+ goes from 0 to the sum of k_i for which alpha_i is true
+    // When alpha_i is false, then all of the k_i corresponding must be noise reads.
+    const category_counts_t filtered_object_counts = filter_by_alpha(alpha, object_counts);
+    const int max_n_positive =
+        std::accumulate(filtered_object_counts.begin(), filtered_object_counts.end(), 0);
+
+    // log p(n^+ | n, epsilon) + log p(k^+ | alpha, n^+) + log sum_{k^-} p(k^- | n^-, delta)
+    auto log_term = [&](int n_positive) {
+        // n_negative is the number of observations made by the error process.
+        int n_negative = n - n_positive;
+        double log_p_n_plus_given_n_epsilon =
+            n_positive_distribution.log_pdf(std::vector<int>({n_positive, n_negative}));
+
+        double log_p_k_positive_given_alpha_n_positive =
+            calculate_log_p_k_positive_given_alpha_n_positive(n_positive, alpha);
+
+        double log_sum_over_k_negative = calculate_log_sum_over_k_negative(
+            n_positive, n_negative, alpha, delta, object_counts);
 
-                log_p_k_n_positive_given_all_terms.push_back(log_p_k_n_positive_given_all);
-            }
+        return log_p_n_plus_given_n_epsilon + log_p_k_positive_given_alpha_n_positive +
+               log_sum_over_k_negative;
+    };
 
-            std::vector<double> p_k_n_positive_given_all =
-                exp<double>(log_p_k_n_positive_given_all_terms);
+    LogSumExp<true> log_p_k_given_all;
+    if (options.truncation_tolerance <= 0 || epsilon <= 0 || epsilon >= 1) {
+        // n_positive is the number of observations not made by the error process.
+        for (int n_positive = 0; n_positive <= max_n_positive; ++n_positive) {
+            log_p_k_given_all.add(log_term(n_positive));
+        }
+        term_counts->evaluated += max_n_positive + 1;
+        return log_p_k_given_all.result();
+    }
 
-            log_alpha_likelyhoods_per_object.at(obs_index).push_back(
-                std::log(stable_sum<double>(p_k_n_positive_given_all)));
+    // Every term is at most p(n^+ | n, epsilon), since the other two factors are probabilities, so
+    // the terms left outside [lower, upper] are bounded by binomial tails. Below the binomial
+    // mode each term is a smaller multiple of the one above it than the last, so the lower tail is
+    // at most a geometric series from p(lower - 1 | n, epsilon), and likewise for the upper tail.
+    // The upper tail is also scaled by p(k^+ | alpha, upper + 1), which decreases in n^+.
+    const double p_positive = 1 - epsilon;
+    auto log_lower_tail = [&](int lower) {
+        if (lower == 0) {
+            return -std::numeric_limits<double>::infinity();
+        }
+        int k = lower - 1;
+        double ratio = k * epsilon / ((n - k + 1) * p_positive);
+        return n_positive_distribution.log_pdf(std::vector<int>({k, n - k})) - std::log1p(-ratio);
+    };
+    auto log_upper_tail = [&](int upper) {
+        if (upper == max_n_positive) {
+            return -std::numeric_limits<double>::infinity();
+        }
+        int k = upper + 1;
+        double ratio = (n - k) * p_positive / ((k + 1) * epsilon);
+        return n_positive_distribution.log_pdf(std::vector<int>({k, n - k})) +
+               calculate_log_p_k_positive_given_alpha_n_positive(k, alpha) - std::log1p(-ratio);
+    };
+
+    int mode = std::min(int((n + 1) * p_positive), max_n_positive);
+    int lower = mode;
+    int upper = mode;
+    log_p_k_given_all.add(log_term(mode));
+    const double log_tolerance = std::log(options.truncation_tolerance);
+    while (true) {
+        double log_lower = log_lower_tail(lower);
+        double log_upper = log_upper_tail(upper);
+        LogSumExp<> log_remaining;
+        log_remaining.add(log_lower);
+        log_remaining.add(log_upper);
+        if (log_remaining.result() <= log_tolerance + log_p_k_given_all.result()) {
+            break;
+        }
+        if (log_lower >= log_upper) {
+            log_p_k_given_all.add(log_term(--lower));
+        } else {
+            log_p_k_given_all.add(log_term(++upper));
         }
     }
-    return log_alpha_likelyhoods_per_object;
+    term_counts->evaluated += upper - lower + 1;
+    term_counts->skipped += max_n_positive + 1 - (upper - lower + 1);
+
+    return log_p_k_given_all.result();
 }
 
 std::vector<std::vector<double>> ModelDistribution::distribution(const std::vector<alpha_t> &alphas,
                                                                  double epsilon,
                                                                  const delta_t &delta) const {
-    std::vector<std::vector<alpha_t>> alphas_per_obs(data.size(), alphas);
+    std::vector<std::vector<alpha_t>> alphas_per_obs(n_objects, alphas);
     return distribution(alphas_per_obs, epsilon, delta);
 }
 
 double ModelDistribution::calculate_log_p_k_positive_given_alpha_n_positive(int n_positive,
                                                                             const alpha_t &alpha) {
-    int sum_alpha = accumulate(alpha.begin(), alpha.end(), 0);
+    int sum_alpha = alpha.count();
 
     // 1/(n^+ + sum alpha_i - 1 choose n^+)
-    // lgamma(x + 1) = log(x!)
-    double log_p_k_given_alpha_n_positive =
-        lgamma(n_positive + 1) + lgamma(sum_alpha) - lgamma(n_positive + sum_alpha);
+    double log_p_k_given_alpha_n_positive = LogFactorial::log_factorial(n_positive) +
+                                            LogFactorial::log_factorial(sum_alpha - 1) -
+                                            LogFactorial::log_factorial(n_positive + sum_alpha - 1);
     return log_p_k_given_alpha_n_positive;
 }
 
@@ -96,194 +228,333 @@ double ModelDistribution::calculate_log_sum_over_k_negative(
 
     int n = n_positive + n_negative;
 
-    delta_t delta_for_alpha_true = filter_by_alpha(alpha, delta);
-
-    double sum_over_k_negative;
-    if (options.comparison) {
-        sum_over_k_negative = calculate_sum_over_k_negative_exact(n_positive, n_negative, alpha,
-                                                                  delta, object_counts);
-        double sum_over_k_negative_approx = calculate_sum_over_k_negative_approx(
+    double log_sum_over_k_negative;
+    if (comparison_report && comparison_report->should_sample()) {
+        auto start = std::chrono::steady_clock::now();
+        log_sum_over_k_negative = calculate_log_sum_over_k_negative_incremental(
+            n_positive, n_negative, alpha, delta, object_counts);
+        auto exact_end = std::chrono::steady_clock::now();
+        NormalApproximation approximation = calculate_normal_approximation(
+            n_negative, alpha, delta, object_counts, options.seed);
+        auto approximation_end = std::chrono::steady_clock::now();
+
+        comparison_report->add(
+            {n_negative, alpha, approximation.dimensions, log_sum_over_k_negative,
+             std::log(approximation.sum()), dispatcher.log_error_bound(approximation),
+             std::chrono::duration<double, std::nano>(exact_end - start).count(),
+             std::chrono::duration<double, std::nano>(approximation_end - exact_end).count()});
+    } else if (!dispatcher.approximation_is_cheaper(n_positive, alpha, object_counts)) {
+        log_sum_over_k_negative = calculate_log_sum_over_k_negative_incremental(
             n_positive, n_negative, alpha, delta, object_counts);
-        double error = sum_over_k_negative - sum_over_k_negative_approx;
-
-        BOOST_LOG_TRIVIAL(info) << "Approximation error: " << std::to_string(error);
     } else {
-        if (!can_use_normal_approx(n_negative, delta_for_alpha_true)) {
-            sum_over_k_negative = calculate_sum_over_k_negative_exact(n_positive, n_negative, alpha,
-                                                                      delta, object_counts);
+        NormalApproximation approximation =
+            calculate_normal_approximation(n_negative, alpha, delta, object_counts, options.seed);
+        if (dispatcher.within_tolerance(approximation)) {
+            log_sum_over_k_negative = std::log(approximation.sum());
         } else {
-            sum_over_k_negative = calculate_sum_over_k_negative_approx(n_positive, n_negative,
-                                                                       alpha, delta, object_counts);
+            log_sum_over_k_negative = calculate_log_sum_over_k_negative_incremental(
+                n_positive, n_negative, alpha, delta, object_counts);
         }
     }
 
-    return std::log(sum_over_k_negative);
+    return log_sum_over_k_negative;
 }
 
+namespace {
+
+/**
+ * Log of the sum of p(k^- | n^-, delta) over every valid k^-, evaluating every term in full. Each
+ * row is evaluated as one batch so the terms are computed in SIMD lanes.
+ */
+template <int N>
+struct ExactKernel {
+    static double run(int n_positive, int n_negative, const alpha_t &alpha, const delta_t &delta,
+                      const category_counts_t &object_counts) {
+        Multinomial k_negative_distribution(n_negative, delta);
+        LogSumExp<true> log_sum_over_k_negative;
+        KNegativeEnumerator<N>::rows(
+            [&log_sum_over_k_negative, &k_negative_distribution](
+                const int *k_negative, int k_start, int k_end) {
+                log_sum_over_k_negative.add(MultinomialBatch::log_sum_row(
+                    k_negative_distribution, k_negative, k_start, k_end));
+            },
+            n_positive, n_negative, alpha, object_counts);
+        return log_sum_over_k_negative.result();
+    }
+};
+
+// With a single category there are no rows, just the one point k_1^- = n^-.
+template <>
+struct ExactKernel<1> {
+    static double run(int n_positive, int n_negative, const alpha_t &alpha, const delta_t &delta,
+                      const category_counts_t &object_counts) {
+        Multinomial k_negative_distribution(n_negative, delta);
+        LogSumExp<true> log_sum_over_k_negative;
+        KNegativeEnumerator<1>::points(
+            [&log_sum_over_k_negative, &k_negative_distribution](const int *k_negative) {
+                log_sum_over_k_negative.add(
+                    k_negative_distribution.log_pdf(std::vector<int>(k_negative, k_negative + 1)));
+            },
+            n_positive, n_negative, alpha, object_counts);
+        return log_sum_over_k_negative.result();
+    }
+};
+
+/**
+ * Same sum as ExactKernel, but each row is walked outwards from its mode with multiplicative
+ * updates, which MultinomialBatch::walk_sum advances several terms at a time in SIMD lanes. Only
+ * the last two components change within a row.
+ */
+template <int N>
+struct IncrementalKernel {
+    static double run(int n_positive, int n_negative, const alpha_t &alpha, const delta_t &delta,
+                      const category_counts_t &object_counts) {
+        Multinomial k_negative_distribution(n_negative, delta);
+        const std::vector<double> &log_p = k_negative_distribution.log_p;
+        const double log_n_negative_factorial = LogFactorial::log_factorial(n_negative);
+
+        // Moving one count from the last component to the varying one multiplies the term by
+        // k_last^- / (k_varying^- + 1) * p_varying / p_last.
+        const int varying = N - 2;
+        const int last = N - 1;
+        const double p_varying_over_p_last = delta.at(varying) / delta.at(last);
+        const double p_last_over_p_varying = delta.at(last) / delta.at(varying);
+        const double p_varying_given_either =
+            delta.at(varying) / (delta.at(varying) + delta.at(last));
+
+        LogSumExp<true> log_sum_over_k_negative;
+
+        KNegativeEnumerator<N>::rows(
+            [&](const int *k_negative, int k_start, int k_end) {
+                // k_varying^- + k_last^- is fixed within a row.
+                int row_n = n_negative;
+                double log_prefix_term = log_n_negative_factorial;
+                for (int i = 0; i < varying; ++i) {
+                    row_n -= k_negative[i];
+                    log_prefix_term +=
+                        k_negative[i] * log_p[i] - LogFactorial::log_factorial(k_negative[i]);
+                }
+
+                // Within a row the terms are proportional to a binomial pmf in k_varying^-, so
+                // they are unimodal. Anchoring at the mode keeps every other term of the row in
+                // (0, 1] relative to the anchor, so the walk can't overflow and only loses
+                // negligible terms to underflow.
+                int anchor = int((row_n + 1) * p_varying_given_either);
+                anchor = std::min(std::max(anchor, k_start), k_end);
+                double log_anchor_term =
+                    log_prefix_term - LogFactorial::log_factorial(anchor) -
+                    LogFactorial::log_factorial(row_n - anchor) + anchor * log_p[varying] +
+                    (row_n - anchor) * log_p[last];
+
+                // The walks up to k_end and down to k_start.
+                double row_sum =
+                    1.0 +
+                    MultinomialBatch::walk_sum(row_n - anchor, anchor + 1, p_varying_over_p_last,
+                                               k_end - anchor) +
+                    MultinomialBatch::walk_sum(anchor, row_n - anchor + 1, p_last_over_p_varying,
+                                               anchor - k_start);
+
+                log_sum_over_k_negative.add(log_anchor_term + std::log(row_sum));
+            },
+            n_positive, n_negative, alpha, object_counts);
+
+        return log_sum_over_k_negative.result();
+    }
+};
+
+// A single category has no row to walk.
+template <>
+struct IncrementalKernel<1> : ExactKernel<1> {};
+
+/**
+ * Names the MVI3 stream for one integration problem by folding n^-, alpha and every object count
+ * (and so n^+ as well) through Philox blocks under the seed. Objects with the same problem share a
+ * stream and objects with different problems don't, whatever order they are evaluated in.
+ */
+uint64_t mvi3_stream(uint64_t seed, int n_negative, const alpha_t &alpha,
+                     const category_counts_t &object_counts) {
+    Philox4x32::key_t key = {{uint32_t(seed), uint32_t(seed >> 32)}};
+    Philox4x32::counter_t state = {{uint32_t(n_negative), uint32_t(alpha.mask()), 0, 0}};
+    for (int count : object_counts) {
+        state[2] ^= uint32_t(count);
+        state = Philox4x32::block(state, key);
+    }
+    return state[0] | uint64_t(state[1]) << 32;
+}
+
+}  // namespace
+
 double ModelDistribution::calculate_sum_over_k_negative_exact(
     int n_positive, int n_negative, const alpha_t &alpha, const delta_t &delta,
     const category_counts_t &object_counts) {
-    Multinomial k_negative_distribution(n_negative, delta);
-
-    std::vector<double> log_p_k_positive_given_delta_n_negative;
-
-    iterate_over_k_negatives(
-        [&log_p_k_positive_given_delta_n_negative, &k_negative_distribution](
-            int k_1_negative, int k_2_negative, int k_3_negative) {
-            log_p_k_positive_given_delta_n_negative.push_back(
-                k_negative_distribution.log_pdf({k_1_negative, k_2_negative, k_3_negative}));
-        },
-        n_positive, n_negative, alpha, object_counts);
+    return std::exp(dispatch_categories<ExactKernel>(object_counts.size(), n_positive, n_negative,
+                                                     alpha, delta, object_counts));
+}
 
-    std::vector<double> p_k_positive_given_delta_n_negative =
-        exp(log_p_k_positive_given_delta_n_negative);
-    return stable_sum<double>(p_k_positive_given_delta_n_negative);
+double ModelDistribution::calculate_log_sum_over_k_negative_incremental(
+    int n_positive, int n_negative, const alpha_t &alpha, const delta_t &delta,
+    const category_counts_t &object_counts) {
+    return dispatch_categories<IncrementalKernel>(object_counts.size(), n_positive, n_negative,
+                                                  alpha, delta, object_counts);
 }
 
-void ModelDistribution::iterate_over_k_negatives(std::function<void(int, int, int)> f,
+void ModelDistribution::iterate_over_k_negatives(const std::function<void(int, int, int)> &f,
                                                  int n_positive, int n_negative,
                                                  const alpha_t &alpha,
                                                  const category_counts_t &object_counts) {
-    // Because some alpha_i might be 0, we have to fix some of the k^- values to start with.
-    std::vector<int> fixed_k_negative = {0, 0, 0};
-    for (int i = 0; i < 3; ++i) {
-        if (alpha.at(i) == false) {
-            fixed_k_negative.at(i) = object_counts.at(i);
-        }
-    }
+    iterate_over_k_negatives<const std::function<void(int, int, int)> &>(
+        f, n_positive, n_negative, alpha, object_counts);
+}
 
-    int k_1_negative_start = std::max({object_counts[0] - n_positive, fixed_k_negative[0],
-                                       n_negative - object_counts[1] - object_counts[2]});
-    int k_1_negative_end =
-        std::min(n_negative - fixed_k_negative[1] - fixed_k_negative[2], object_counts[0]);
-    for (int k_1_negative = k_1_negative_start; k_1_negative <= k_1_negative_end; ++k_1_negative) {
-        int k_2_negative_start = std::max({object_counts[1] - n_positive, fixed_k_negative[1],
-                                           n_negative - k_1_negative - object_counts[2]});
-        int k_2_negative_end =
-            std::min(n_negative - k_1_negative - fixed_k_negative[2], object_counts[1]);
-        for (int k_2_negative = k_2_negative_start; k_2_negative <= k_2_negative_end;
-             ++k_2_negative) {
-            int k_3_negative = n_negative - k_1_negative - k_2_negative;
-            if (alpha[2] == false && k_3_negative == object_counts[2] ||
-                alpha[2] == true && k_3_negative >= 0 && k_3_negative <= object_counts[2]) {
-                f(k_1_negative, k_2_negative, k_3_negative);
-            }
-        }
-    }
+void ModelDistribution::iterate_over_k_negative_rows(const std::function<void(int, int, int)> &f,
+                                                     int n_positive, int n_negative,
+                                                     const alpha_t &alpha,
+                                                     const category_counts_t &object_counts) {
+    iterate_over_k_negative_rows<const std::function<void(int, int, int)> &>(
+        f, n_positive, n_negative, alpha, object_counts);
 }
 
 double ModelDistribution::calculate_sum_over_k_negative_approx(
     int n_positive, int n_negative, const alpha_t &alpha, const delta_t &delta,
     const category_counts_t &object_counts) {
-    std::vector<bool> object_count_nonzero(object_counts.size(), false);
-    std::transform(object_counts.begin(), object_counts.end(), object_count_nonzero.begin(),
-                   [](int count) { return count > 0; });
+    return calculate_normal_approximation(n_negative, alpha, delta, object_counts).sum();
+}
 
-    std::vector<bool> effective_alpha;
+NormalApproximation ModelDistribution::calculate_normal_approximation(
+    int n_negative, const alpha_t &alpha, const delta_t &delta,
+    const category_counts_t &object_counts, uint64_t seed) {
+    alpha_t effective_alpha = alpha;
     for (int i = 0; i < alpha.size(); ++i) {
-        effective_alpha.push_back(alpha.at(i) && object_count_nonzero.at(i));
+        if (object_counts.at(i) == 0) {
+            effective_alpha.set(i, false);
+        }
     }
 
     category_counts_t filtered_object_counts = filter_by_alpha(effective_alpha, object_counts);
 
-    if (effective_alpha == std::vector<bool>({0, 0, 0})) {
-        return 0;
+    NormalApproximation approximation = {0.0, 0.0, 0, 0.0};
+    if (effective_alpha.none()) {
+        return approximation;
     }
 
     Multinomial m_fixed =
         Multinomial(n_negative, delta)
-            .fix_dimensions(not_v(effective_alpha),
+            .fix_dimensions((~effective_alpha).to_vector(),
                             filter_by_alpha(effective_alpha, object_counts, false));
-
-    double sum_over_k_negative_approx;
-    if (m_fixed.p.size() > 1) {
+    approximation.log_adjust = m_fixed.log_adjust;
+    approximation.dimensions = m_fixed.p.size() - 1;
+    approximation.min_mean_count =
+        m_fixed.n * *std::min_element(m_fixed.p.begin(), m_fixed.p.end());
+
+    if (m_fixed.n <= 0) {
+        // The free categories' k^- are all zero, or there is no valid k^-.
+        approximation.probability = m_fixed.n == 0 ? 1.0 : 0.0;
+    } else if (m_fixed.p.size() > 1) {
         MultivariateGuassian mg = MultivariateGuassian::from_multinomial(m_fixed);
         std::vector<std::vector<double>> hyperplanes =
             ModelDistribution::get_hyperplanes(m_fixed.n, filtered_object_counts);
         mg.shift_hyperplanes(hyperplanes);
 
-        MVI3::Mvi3 mvi3;
-        double log_sum_over_k_negative_approx =
-            std::log(mvi3.integrate(12456, -1, 10, 10, mg.get_covariance(), hyperplanes)) +
-            m_fixed.log_adjust;
-
-        sum_over_k_negative_approx = std::exp(log_sum_over_k_negative_approx);
+        if (approximation.dimensions <= MAX_CLOSED_FORM_DIMENSIONS) {
+            approximation.probability =
+                gaussian_polytope_probability(mg.get_covariance(), hyperplanes);
+        } else {
+            Philox4x32 seeds(seed, mvi3_stream(seed, n_negative, effective_alpha, object_counts));
+            MVI3::Mvi3 mvi3;
+            approximation.probability = mvi3.integrate(seeds() & 0x7fffffff, -1, 10, 10,
+                                                       mg.get_covariance(), hyperplanes);
+        }
     } else {
         if (filtered_object_counts.size() > 0 && filtered_object_counts.back() >= m_fixed.n) {
-            sum_over_k_negative_approx = std::exp(m_fixed.log_adjust);
+            approximation.probability = 1.0;
             // TODO(joschnei): condition above is wrong. Need to check both n+ and n-b
-        } else {
-            sum_over_k_negative_approx = 0;
         }
     }
-    return sum_over_k_negative_approx;
+    return approximation;
 }
 
 double ModelDistribution::calculate_sum_over_k_negative_approx_2(
     int n_positive, int n_negative, const alpha_t &alpha, const delta_t &delta,
-    const category_counts_t &object_counts) {
+    const category_counts_t &object_counts, std::default_random_engine &generator) {
     Multinomial m_fixed =
         Multinomial(n_negative, delta)
-            .fix_dimensions(not_v(alpha), filter_by_alpha(alpha, object_counts, false));
+            .fix_dimensions((~alpha).to_vector(), filter_by_alpha(alpha, object_counts, false));
     MultivariateGuassian mg = MultivariateGuassian::from_multinomial(m_fixed);
 
-    std::function<double(std::vector<double>)> multivariate_guassian_density =
-        [mg](std::vector<double> point) { return mg.density(point); };
-
-    std::function<std::vector<double>(std::default_random_engine &)> sampler =
-        [m_fixed, object_counts = filter_by_alpha(alpha, object_counts)](
-            std::default_random_engine &generator) {
-            int dim = m_fixed.p.size();
+    category_counts_t filtered_object_counts = filter_by_alpha(alpha, object_counts);
+    int dimensions = m_fixed.p.size() - 1;
+
+    // Draw k^- from the slice of the free categories with the right sum directly, so no point is
+    // wasted outside it.
+    KNegativeSliceSampler sampler(
+        m_fixed.n,
+        std::vector<double>(filtered_object_counts.begin(), filtered_object_counts.end()));
+    auto multivariate_guassian_density_sum = [&mg, dimensions](const std::vector<double> &points,
+                                                               const std::vector<double> &weights,
+                                                               int n_points) {
+        Eigen::Map<const Eigen::MatrixXd> block(points.data(), dimensions, n_points);
+        Eigen::Map<const Eigen::ArrayXd> block_weights(weights.data(), n_points);
+        return (mg.log_density_batch(block).array().exp() * block_weights).sum();
+    };
+
+    IntegrationEstimate integral =
+        integrate_qmc_blocks(multivariate_guassian_density_sum, sampler, dimensions, generator);
+    return std::exp(std::log(integral.value) + m_fixed.log_adjust);
+}
 
-            std::vector<std::uniform_real_distribution<double>> dists;
-            for (int i = 0; i < dim - 1; ++i) {
-                dists.push_back(std::uniform_real_distribution<double>(0.0, object_counts.at(i)));
-            }
+ImportanceEstimate ModelDistribution::calculate_sum_over_k_negative_importance(
+    int n_negative, const alpha_t &alpha, const delta_t &delta,
+    const category_counts_t &object_counts, std::default_random_engine &generator,
+    double defensive_fraction, const IntegrationOptions &options) {
+    Multinomial m_fixed =
+        Multinomial(n_negative, delta)
+            .fix_dimensions((~alpha).to_vector(), filter_by_alpha(alpha, object_counts, false));
+    MultivariateGuassian mg = MultivariateGuassian::from_multinomial(m_fixed);
 
-            std::vector<double> point;
-            double last_component;
-            do {
-                point = std::vector<double>();
-                for (std::uniform_real_distribution<double> dist : dists) {
-                    point.push_back(dist(generator));
-                }
-                last_component = m_fixed.n - std::accumulate(point.begin(), point.end(), 0.0);
-            } while (!(0 <= last_component && last_component <= object_counts.back()));
-            return point;
-        };
-
-    double volume;
-    if (m_fixed.p.size() == 3) {
-        volume = n_negative * object_counts.at(2) - std::pow(object_counts.at(2), 2) / 2.0;
-        if (n_negative > object_counts.at(0)) {
-            volume -= 1.0 / 2.0 * std::pow(n_negative - object_counts.at(0), 2);
-            if (n_negative - object_counts.at(2) > object_counts.at(0)) {
-                volume +=
-                    1.0 / 2.0 * std::pow(n_negative - object_counts.at(2) - object_counts.at(0), 2);
-            }
-        }
-        if (n_negative > object_counts.at(1)) {
-            volume -= 1.0 / 2.0 * std::pow(n_negative - object_counts.at(1), 2);
-            if (n_negative - object_counts.at(2) > object_counts.at(1)) {
-                volume +=
-                    1.0 / 2.0 * std::pow(n_negative - object_counts.at(2) - object_counts.at(1), 2);
-            }
-        }
-        if (n_negative > object_counts.at(0) + object_counts.at(1)) {
-            volume +=
-                1.0 / 2.0 * std::pow(n_negative - object_counts.at(0) - object_counts.at(1), 2);
+    category_counts_t filtered_object_counts = filter_by_alpha(alpha, object_counts);
+    int dimensions = m_fixed.p.size() - 1;
+    KNegativeSliceSampler slice_sampler(
+        m_fixed.n,
+        std::vector<double>(filtered_object_counts.begin(), filtered_object_counts.end()));
+
+    // The weight of x is phi(x) / ((1 - defensive_fraction) phi(x) + defensive_fraction q(x)) for
+    // the guassian density phi and slice density q, which is zero outside the slice.
+    auto block_weights = [&](std::default_random_engine &generator, int n_points,
+                             std::vector<double> &weights) {
+        std::binomial_distribution<int> n_defensive_distribution(n_points, defensive_fraction);
+        int n_defensive = n_defensive_distribution(generator);
+
+        Eigen::MatrixXd points(dimensions, n_points);
+        points.leftCols(n_points - n_defensive) =
+            mg.sample_batch(generator, n_points - n_defensive);
+        std::uniform_real_distribution<double> uniform;
+        std::vector<double> u(n_defensive * dimensions);
+        for (double &u_i : u) {
+            u_i = uniform(generator);
         }
-        if (n_negative - object_counts.at(2) < 0) {
-            volume += 1.0 / 2.0 * std::pow(n_negative - object_counts.at(2), 2.0);
+        std::vector<double> slice_points(n_defensive * dimensions);
+        std::vector<double> slice_weights(n_defensive);
+        slice_sampler(u, n_defensive, slice_points, slice_weights);
+        points.rightCols(n_defensive) =
+            Eigen::Map<const Eigen::MatrixXd>(slice_points.data(), dimensions, n_defensive);
+
+        Eigen::VectorXd log_densities = mg.log_density_batch(points);
+        for (int j = 0; j < n_points; ++j) {
+            double slice_density = slice_sampler.density(points.col(j).data());
+            weights[j] =
+                slice_density > 0
+                    ? 1.0 / (1 - defensive_fraction +
+                             defensive_fraction * std::exp(std::log(slice_density) -
+                                                           log_densities[j]))
+                    : 0.0;
         }
-    } else if (m_fixed.p.size() == 2) {
-        volume = std::min(n_negative, object_counts.at(0)) -
-                 std::max(0, n_negative - object_counts.at(1));
-    }
+    };
 
-    return std::exp(
-        std::log(integrate(multivariate_guassian_density, sampler, generator, volume, 500000)) +
-        m_fixed.log_adjust);
+    ImportanceEstimate estimate = importance_sample(block_weights, generator, options);
+    double scale = std::exp(m_fixed.log_adjust);
+    estimate.value *= scale;
+    estimate.standard_error *= scale;
+    return estimate;
 }
 
 /**
@@ -326,16 +597,4 @@ std::vector<std::vector<double>> ModelDistribution::get_hyperplanes(
 
     return hyperplanes;
 }
-
-bool ModelDistribution::can_use_normal_approx(int n_negative, const delta_t &delta) const {
-    if (options.exact) {
-        return false;
-    }
-    for (double p : delta) {
-        if (n_negative * p <= 5.0) {
-            return false;
-        }
-    }
-    return true;
-}
 }  // namespace FilterModel
\ No newline at end of file
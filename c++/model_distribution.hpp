@@ -1,11 +1,20 @@
 #ifndef MODEL_DISTRIBUTION_HPP
 #define MODEL_DISTRIBUTION_HPP
 
+#include "approximation_dispatcher.hpp"
+#include "comparison_report.hpp"
 #include "gtest/gtest_prod.h"
+#include "k_negative_enumerator.hpp"
+#include "monte_carlo_integration.hpp"
+#include "thread_pool.hpp"
 #include "types.hpp"
 
 #include <algorithm>
+#include <atomic>
 #include <boost/log/trivial.hpp>
+#include <functional>
+#include <map>
+#include <memory>
 #include <numeric>
 #include <random>
 #include <unordered_map>
@@ -24,13 +33,11 @@ class ModelDistribution {
      *
      * Arguments:
      *  data - vector of category counts
-     *  generator - random number generator
-     *  comparison - test parameter, should usually ignore. If true, runs both exact and approximate
-     *    methods for evaluating the probability, compares them, and stops the program if the
-     *    estimates are too far apart.
+     *  options - see Options. If options.comparison is true, a fraction options.comparison_fraction
+     *    of the sums over k^- are evaluated both exactly and approximately and summarised in the
+     *    report get_comparison_report returns. The exact value is the one used.
      */
-    ModelDistribution(const std::vector<category_counts_t> &data,
-                      std::default_random_engine &generator, const Options &options);
+    ModelDistribution(const std::vector<category_counts_t> &data, const Options &options);
 
     /**
      * Calculates log(p(k | alpha, epsilon, delta)) for every object in the data for every value
@@ -59,6 +66,27 @@ class ModelDistribution {
     std::vector<std::vector<double>> distribution(const std::vector<alpha_t> &alphas,
                                                   double epsilon, const delta_t &delta) const;
 
+    /**
+     * Returns the number of n^+ terms evaluated, and skipped by truncation_tolerance, over every
+     * call to distribution so far, by this object and its copies.
+     */
+    long get_evaluated_terms() const { return term_counts->evaluated; }
+    long get_skipped_terms() const { return term_counts->skipped; }
+
+    /**
+     * Returns the thread pool shared by this object and its copies, or null when running on a
+     * single thread. It must not be used from inside a call to distribution.
+     */
+    ThreadPool *get_thread_pool() const { return thread_pool.get(); }
+
+    /**
+     * Returns the comparison report shared by this object and its copies, or null unless
+     * options.comparison is set.
+     */
+    const std::shared_ptr<ComparisonReport> &get_comparison_report() const {
+        return comparison_report;
+    }
+
     // The following are public only so I can test them easier. FRIEND_TEST exists, but it doesn't
     // work right for static methods.
 
@@ -71,20 +99,87 @@ class ModelDistribution {
     static double calculate_sum_over_k_negative_exact(int n_positive, int n_negative,
                                                       const alpha_t &alpha, const delta_t &delta,
                                                       const category_counts_t &object_counts);
+    /**
+     * Calculates the log of the sum calculate_sum_over_k_negative_exact calculates, but walks each
+     * row of fixed k_1^-, ..., k_{d-2}^- with multiplicative updates between neighbouring terms
+     * instead of evaluating every term from scratch. Each row is re-anchored with one full
+     * evaluation at its mode. Staying in log space means large counts don't underflow to log(0).
+     */
+    static double calculate_log_sum_over_k_negative_incremental(
+        int n_positive, int n_negative, const alpha_t &alpha, const delta_t &delta,
+        const category_counts_t &object_counts);
 
-    // Uses MVI3 integration
+    // Uses the closed form gaussian_polytope_probability when the normal approximation has at most
+    // two dimensions, and MVI3 integration otherwise.
     static double calculate_sum_over_k_negative_approx(int n_positive, int n_negative,
                                                        const alpha_t &alpha, const delta_t &delta,
                                                        const category_counts_t &object_counts);
+    // The parts of calculate_sum_over_k_negative_approx the dispatcher needs to estimate its error.
+    // MVI3 is seeded from seed, n^-, alpha and the object counts, so its estimate doesn't depend
+    // on the call order.
+    static NormalApproximation calculate_normal_approximation(
+        int n_negative, const alpha_t &alpha, const delta_t &delta,
+        const category_counts_t &object_counts, uint64_t seed = 0);
+    // Uses randomised quasi Monte-Carlo integration of the same normal approximation, stopping at a
+    // relative standard error of 1e-3. Not currently used by log_likelyhood.
+    static double calculate_sum_over_k_negative_approx_2(int n_positive, int n_negative,
+                                                         const alpha_t &alpha,
+                                                         const delta_t &delta,
+                                                         const category_counts_t &object_counts,
+                                                         std::default_random_engine &generator);
+    /**
+     * Estimates the same integral as calculate_sum_over_k_negative_approx_2 by importance
+     * sampling from a defensive mixture: the approximating guassian itself with probability
+     * 1 - defensive_fraction, and KNegativeSliceSampler otherwise. Guassian draws outside the
+     * slice get weight zero, and the slice component bounds the weights where the guassian puts
+     * little mass. The value and standard error include the fixed categories' factor.
+     */
+    static ImportanceEstimate calculate_sum_over_k_negative_importance(
+        int n_negative, const alpha_t &alpha, const delta_t &delta,
+        const category_counts_t &object_counts, std::default_random_engine &generator,
+        double defensive_fraction = 0.1, const IntegrationOptions &options = IntegrationOptions());
     /**
      * Given n^+, n^-, alpha, and k, loop over all possible values for k^-, and call f() on each.
      *
-     * This is hard-coded for |alpha|=3. Doing this in a generic way was incredibly slow.
+     * This is the three category form used by the tests and the command line tools. Kernels that
+     * should work for any number of categories use KNegativeEnumerator directly.
+     *
+     * f can be any callable taking (k_1^-, k_2^-, k_3^-). Passing a lambda directly (rather than
+     * through a std::function) lets the compiler inline it into the loop.
      */
-    static void iterate_over_k_negatives(std::function<void(int, int, int)> f, int n_positive,
-                                         int n_negative, const alpha_t &alpha,
+    template <class F>
+    static void iterate_over_k_negatives(F &&f, int n_positive, int n_negative,
+                                         const alpha_t &alpha,
+                                         const category_counts_t &object_counts) {
+        KNegativeEnumerator<3>::points(
+            [&f](const int *k_negative) { f(k_negative[0], k_negative[1], k_negative[2]); },
+            n_positive, n_negative, alpha, object_counts);
+    }
+    static void iterate_over_k_negatives(const std::function<void(int, int, int)> &f,
+                                         int n_positive, int n_negative, const alpha_t &alpha,
                                          const category_counts_t &object_counts);
 
+    /**
+     * Given n^+, n^-, alpha, and k, loop over every value of k_1^- with at least one valid k^-,
+     * and call f(k_1^-, k_2^- start, k_2^- end) with the inclusive range of valid k_2^-. k_3^- is
+     * always n^- - k_1^- - k_2^-. Three categories only, like iterate_over_k_negatives.
+     *
+     * Handing back whole k_2^- ranges lets kernels run their own tight loop over a row.
+     */
+    template <class F>
+    static void iterate_over_k_negative_rows(F &&f, int n_positive, int n_negative,
+                                             const alpha_t &alpha,
+                                             const category_counts_t &object_counts) {
+        KNegativeEnumerator<3>::rows(
+            [&f](const int *k_negative, int k_2_negative_start, int k_2_negative_end) {
+                f(k_negative[0], k_2_negative_start, k_2_negative_end);
+            },
+            n_positive, n_negative, alpha, object_counts);
+    }
+    static void iterate_over_k_negative_rows(const std::function<void(int, int, int)> &f,
+                                             int n_positive, int n_negative, const alpha_t &alpha,
+                                             const category_counts_t &object_counts);
+
     /**
      * Removes components of v for which alpha_i has the wrong value.
      */
@@ -94,6 +189,7 @@ class ModelDistribution {
         assert(alpha.size() == v.size());
 
         std::vector<T> filtered;
+        filtered.reserve(value ? alpha.count() : alpha.size() - alpha.count());
         for (int i = 0; i < alpha.size(); ++i) {
             if (alpha.at(i) == value) {
                 filtered.push_back(v.at(i));
@@ -103,27 +199,34 @@ class ModelDistribution {
     }
 
    private:
-    const std::vector<category_counts_t> &data;
     const Options options;
-    std::default_random_engine &generator;
+    // Chooses between the exact and approximate sums over k^-.
+    const ApproximationDispatcher dispatcher;
+    // Shared between copies, since the sampling lambdas capture ModelDistributions by value. Null
+    // when running on a single thread.
+    std::shared_ptr<ThreadPool> thread_pool;
+
+    struct TermCounts {
+        std::atomic<long> evaluated{0};
+        std::atomic<long> skipped{0};
+    };
+    // Shared between copies, like thread_pool.
+    std::shared_ptr<TermCounts> term_counts;
+    // Shared between copies, like thread_pool. Null unless options.comparison is set.
+    std::shared_ptr<ComparisonReport> comparison_report;
+
+    const size_t n_objects;
+    // Each distinct count vector in the data, in order of first appearance.
+    std::vector<category_counts_t> unique_data;
+    // unique_data index of each object's counts.
+    std::vector<int> unique_index_per_object;
 
     /**
-     * Test for if using a normal approximation (and mvi3 integration) is permissible.
-     *
-     * There is no real standard for when the multinomial to multivariate guassian approximation
-     * is valid, so we adapt the standard binomial to guassian rule, which is that there is a
-     * mean of at least 5 elements in every dimension.
-     *
-     * TODO(joschnei): Verify experimentally that this is a good heuristic.
+     * Calculates log(p(k | alpha, epsilon, delta)) for a single object with the given counts.
      */
-    bool can_use_normal_approx(int n_negative, const delta_t &delta) const;
-
-    // The below are currently not in use beacuse of randomness problems.
+    double log_likelyhood(const category_counts_t &object_counts, const alpha_t &alpha,
+                          double epsilon, const delta_t &delta) const;
 
-    // Uses naive Monte-Carlo integration
-    double calculate_sum_over_k_negative_approx_2(int n_positive, int n_negative,
-                                                  const alpha_t &alpha, const delta_t &delta,
-                                                  const category_counts_t &object_counts);
     /**
      * Creates a hyperplane array representing the constraints on k_minus for use in mvi3
      * integration.
@@ -1,7 +1,15 @@
 #ifndef MONTE_CARLO_INTEGRATION_HPP
 #define MONTE_CARLO_INTEGRATION_HPP
 
+#include "sobol_sequence.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <functional>
+#include <random>
+#include <vector>
 
 namespace FilterModel {
 
@@ -15,6 +23,232 @@ double integrate(const std::function<double(T)> f, const std::function<T(generat
     }
     return volume / iterations * sum;
 }
+
+/**
+ * An integral estimated from several independently randomised point sets.
+ */
+struct IntegrationEstimate {
+    double value;
+    // The standard error of value, from the spread of the replicate estimates.
+    double standard_error;
+    // Points evaluated per replicate.
+    long n_points;
+};
+
+/**
+ * Controls when integrate_qmc stops adding points.
+ */
+struct IntegrationOptions {
+    // Stop once the standard error is at most max(absolute_tolerance, relative_tolerance * value).
+    double absolute_tolerance = 0.0;
+    double relative_tolerance = 1e-3;
+    // Independently shifted copies of the point set. The standard error has replicates - 1
+    // degrees of freedom.
+    int replicates = 8;
+    // Points per replicate in the first round, doubled each round up to max_points. Both should
+    // be powers of two.
+    long min_points = 256;
+    long max_points = 1 << 16;
+};
+
+// Points per block handed to an integrand and, with a thread pool, per parallel task.
+const long QMC_BLOCK_SIZE = 1024;
+
+/**
+ * Estimates the integral of f over a domain with randomised quasi Monte Carlo, a block of points at
+ * a time.
+ *
+ * block_sampler: A callable void(const std::vector<double> &u, int n_points,
+ *   std::vector<double> &points, std::vector<double> &weights) mapping n_points points of the unit
+ *   cube onto the domain in one call. Point j is stored in u[j * dimensions, (j + 1) * dimensions)
+ *   and the same range of points, i.e. row major with one row per point. weights[j] is the
+ *   inverse of the density the point was drawn with, e.g. the volume for a uniform sampler, or
+ *   zero for points outside the domain. The buffers hold QMC_BLOCK_SIZE points and are allocated
+ *   once per block, so a sampler should only write to them. See KNegativeSliceSampler.
+ * block_sum: A callable double(const std::vector<double> &points,
+ *   const std::vector<double> &weights, int n_points) returning the sum of weights[j] * f(point j).
+ * generator: Draws the random digital shift of each replicate, so the estimate is unbiased and
+ *   repeatable for a given generator state.
+ * thread_pool: If given, the blocks of each round run in parallel. Blocks are reduced in a fixed
+ *   order, so the result does not depend on the number of threads. Must not be called from a task
+ *   already running on the same pool.
+ *
+ * Each replicate is a Sobol sequence XORed with its own random shift. The points of every round
+ * are added to those of the previous ones, so stopping early never wastes evaluations.
+ */
+template <class BlockSum, class BlockSampler>
+IntegrationEstimate integrate_qmc_blocks(const BlockSum &block_sum,
+                                         const BlockSampler &block_sampler, int dimensions,
+                                         std::default_random_engine &generator,
+                                         const IntegrationOptions &options = IntegrationOptions(),
+                                         ThreadPool *thread_pool = nullptr) {
+    const int replicates = options.replicates;
+
+    SobolSequence sequence(dimensions);
+    std::uniform_int_distribution<uint32_t> shift_distribution;
+    std::vector<uint32_t> shifts(replicates * dimensions);
+    for (uint32_t &shift : shifts) {
+        shift = shift_distribution(generator);
+    }
+
+    std::vector<double> sums(replicates, 0.0);
+    IntegrationEstimate estimate = {0.0, 0.0, 0};
+    long end = std::min(options.min_points, options.max_points);
+    while (true) {
+        long start = estimate.n_points;
+        long n_blocks = (end - start + QMC_BLOCK_SIZE - 1) / QMC_BLOCK_SIZE;
+        std::vector<double> block_sums(replicates * n_blocks);
+
+        std::function<void(int)> run_block = [&](int task) {
+            int replicate = task / n_blocks;
+            long block_start = start + (task % n_blocks) * QMC_BLOCK_SIZE;
+            long block_end = std::min(block_start + QMC_BLOCK_SIZE, end);
+            int n_points = block_end - block_start;
+            const uint32_t *shift = &shifts[replicate * dimensions];
+
+            std::vector<uint32_t> bits(dimensions);
+            std::vector<double> u(n_points * dimensions);
+            std::vector<double> points(n_points * dimensions);
+            std::vector<double> weights(n_points);
+            sequence.at(block_start, bits.data());
+            for (long i = block_start; i < block_end; ++i) {
+                double *u_i = &u[(i - block_start) * dimensions];
+                for (int d = 0; d < dimensions; ++d) {
+                    u_i[d] = ((bits[d] ^ shift[d]) + 0.5) / 4294967296.0;
+                }
+                sequence.next(i, bits.data());
+            }
+            block_sampler(u, n_points, points, weights);
+            block_sums[task] = block_sum(points, weights, n_points);
+        };
+        if (thread_pool) {
+            thread_pool->parallel_for(replicates * n_blocks, run_block);
+        } else {
+            for (int task = 0; task < replicates * n_blocks; ++task) {
+                run_block(task);
+            }
+        }
+        for (int task = 0; task < replicates * n_blocks; ++task) {
+            sums[task / n_blocks] += block_sums[task];
+        }
+        estimate.n_points = end;
+
+        double mean = 0.0;
+        for (double sum : sums) {
+            mean += sum / end;
+        }
+        mean /= replicates;
+        double variance = 0.0;
+        for (double sum : sums) {
+            variance += (sum / end - mean) * (sum / end - mean);
+        }
+        variance /= std::max(replicates - 1, 1);
+
+        estimate.value = mean;
+        estimate.standard_error = std::sqrt(variance / replicates);
+        double tolerance =
+            std::max(options.absolute_tolerance, options.relative_tolerance * estimate.value);
+        if (estimate.standard_error <= tolerance || end >= options.max_points) {
+            return estimate;
+        }
+        end = std::min(2 * end, options.max_points);
+    }
+}
+
+/**
+ * integrate_qmc_blocks for an integrand and sampler evaluated one point at a time, estimating
+ * volume * E[f(sampler(U))] for U uniform on the unit cube.
+ *
+ * f: A callable double(const std::vector<double> &point).
+ * sampler: A callable void(const std::vector<double> &u, std::vector<double> &point) mapping
+ *   the dimensions coordinates of u in (0, 1) onto the domain. The integrand may return 0 outside
+ *   the region being integrated over, in place of rejection sampling.
+ */
+template <class F, class Sampler>
+IntegrationEstimate integrate_qmc(const F &f, const Sampler &sampler, int dimensions,
+                                  double volume, std::default_random_engine &generator,
+                                  const IntegrationOptions &options = IntegrationOptions(),
+                                  ThreadPool *thread_pool = nullptr) {
+    auto block_sampler = [&sampler, dimensions, volume](const std::vector<double> &u, int n_points,
+                                                        std::vector<double> &points,
+                                                        std::vector<double> &weights) {
+        std::vector<double> u_j(dimensions);
+        std::vector<double> point(dimensions);
+        for (int j = 0; j < n_points; ++j) {
+            std::copy(u.begin() + j * dimensions, u.begin() + (j + 1) * dimensions, u_j.begin());
+            sampler(u_j, point);
+            std::copy(point.begin(), point.end(), points.begin() + j * dimensions);
+            weights[j] = volume;
+        }
+    };
+    auto block_sum = [&f, dimensions](const std::vector<double> &points,
+                                      const std::vector<double> &weights, int n_points) {
+        std::vector<double> point(dimensions);
+        double sum = 0.0;
+        for (int j = 0; j < n_points; ++j) {
+            std::copy(points.begin() + j * dimensions, points.begin() + (j + 1) * dimensions,
+                      point.begin());
+            sum += weights[j] * f(point);
+        }
+        return sum;
+    };
+    return integrate_qmc_blocks(block_sum, block_sampler, dimensions, generator, options,
+                                thread_pool);
+}
+/**
+ * An integral estimated by importance sampling.
+ */
+struct ImportanceEstimate {
+    double value;
+    double standard_error;
+    // (sum w)^2 / sum w^2 for the importance weights w. Far fewer than n_points means a few
+    // points carry most of the weight and standard_error is not to be trusted.
+    double effective_sample_size;
+    long n_points;
+};
+
+/**
+ * Estimates an integral as the mean of importance weights f(x) / q(x) for points x drawn from a
+ * proposal density q, adding points until the standard error meets the tolerances of options.
+ * options.replicates is not used.
+ *
+ * block_weights: A callable void(std::default_random_engine &generator, int n_points,
+ *   std::vector<double> &weights) drawing n_points points from the proposal and writing their
+ *   weights to weights, which holds QMC_BLOCK_SIZE entries.
+ */
+template <class BlockWeights>
+ImportanceEstimate importance_sample(const BlockWeights &block_weights,
+                                     std::default_random_engine &generator,
+                                     const IntegrationOptions &options = IntegrationOptions()) {
+    double sum = 0.0;
+    double sum_of_squares = 0.0;
+    std::vector<double> weights(QMC_BLOCK_SIZE);
+    ImportanceEstimate estimate = {0.0, 0.0, 0.0, 0};
+    long end = std::min(options.min_points, options.max_points);
+    while (true) {
+        for (long start = estimate.n_points; start < end; start += QMC_BLOCK_SIZE) {
+            int n_points = std::min(QMC_BLOCK_SIZE, end - start);
+            block_weights(generator, n_points, weights);
+            for (int j = 0; j < n_points; ++j) {
+                sum += weights[j];
+                sum_of_squares += weights[j] * weights[j];
+            }
+        }
+        estimate.n_points = end;
+
+        estimate.value = sum / end;
+        double variance = std::max(sum_of_squares / end - estimate.value * estimate.value, 0.0) *
+                          end / std::max(end - 1, 1L);
+        estimate.standard_error = std::sqrt(variance / end);
+        estimate.effective_sample_size = sum_of_squares > 0 ? sum * sum / sum_of_squares : 0.0;
+        double tolerance =
+            std::max(options.absolute_tolerance, options.relative_tolerance * estimate.value);
+        if (estimate.standard_error <= tolerance || end >= options.max_points) {
+            return estimate;
+        }
+        end = std::min(2 * end, options.max_points);
+    }
+}
 }  // namespace FilterModel
 
-#endif
\ No newline at end of file
+#endif
@@ -1,5 +1,6 @@
 #include "multinomial.hpp"
 
+#include "log_factorial.hpp"
 #include "utils.hpp"
 
 #include <boost/log/trivial.hpp>
@@ -9,7 +10,7 @@
 namespace FilterModel {
 
 Multinomial::Multinomial(int n, std::vector<double> p, double log_adjust)
-    : n(n), p(p), log_adjust(log_adjust) {
+    : n(n), p(p), log_p(FilterModel::log(p)), log_adjust(log_adjust) {
     assert(n >= 0);
     assert_probability(p);
 };
@@ -30,12 +31,13 @@ Multinomial Multinomial::fix_dimensions(std::vector<bool> is_dimension_fixed,
 
     int new_n = n - std::accumulate(fixed_counts.begin(), fixed_counts.end(), 0);
 
-    double log_adjust = std::lgamma(n + 1) - std::lgamma(new_n + 1);
+    double log_adjust =
+        LogFactorial::log_factorial(n) - LogFactorial::log_factorial(new_n);
 
     // Adjust fo the alpha=false terms.
     for (int index : bool_to_index<int>(is_dimension_fixed)) {
-        log_adjust += fixed_counts.at(index) * std::log(p.at(index));
-        log_adjust -= std::lgamma(fixed_counts.at(index) + 1);
+        log_adjust += fixed_counts.at(index) * log_p.at(index);
+        log_adjust -= LogFactorial::log_factorial(fixed_counts.at(index));
     }
     log_adjust += new_n * std::log(norm_p);
 
@@ -53,11 +55,11 @@ double Multinomial::log_pdf(const std::vector<int> &k) const {
         return std::log(1);
     }
 
-    double log_n_choose_k = std::lgamma(n + 1);
+    double log_n_choose_k = LogFactorial::log_factorial(n);
     double log_prod_p_k = 0.0;
     for (int i = 0; i < k.size(); ++i) {
-        log_n_choose_k -= std::lgamma(k.at(i) + 1);
-        log_prod_p_k += k.at(i) * std::log(p.at(i));
+        log_n_choose_k -= LogFactorial::log_factorial(k.at(i));
+        log_prod_p_k += k.at(i) * log_p.at(i);
     }
     return log_n_choose_k + log_prod_p_k + log_adjust;
 }
@@ -23,6 +23,8 @@ class Multinomial {
                                std::vector<int> fixed_counts) const;
     const int n;
     const std::vector<double> p;
+    // log(p), cached so that log_pdf doesn't take a log per term.
+    const std::vector<double> log_p;
     const double log_adjust = 0;
 };
 }  // namespace FilterModel
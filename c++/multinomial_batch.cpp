@@ -0,0 +1,306 @@
+#include "multinomial_batch.hpp"
+
+#include "log_factorial.hpp"
+#include "log_sum_exp.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define FILTER_MODEL_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+namespace FilterModel {
+
+namespace {
+
+// Number of terms evaluated per block. Blocks live on the stack.
+const int BLOCK_SIZE = 256;
+
+// Terms more than this far below the maximum are treated as 0. exp(-700) ~ 1e-304, far below
+// double precision relative to the maximum term, which contributes 1.
+const double MIN_SHIFTED_EXPONENT = -700.0;
+
+double scalar_max(const double *x, int count) {
+    double max = -INFINITY;
+    for (int i = 0; i < count; ++i) {
+        max = std::max(max, x[i]);
+    }
+    return max;
+}
+
+double scalar_sum_exp(const double *x, int count, double shift) {
+    double sum = 0.0;
+    for (int i = 0; i < count; ++i) {
+        sum += std::exp(x[i] - shift);
+    }
+    return sum;
+}
+
+// Sum of the terms after ratios j_start, ..., j_end - 1, starting from term.
+double scalar_walk_sum(double a, double b, double ratio, int j_start, int j_end, double term) {
+    double sum = 0.0;
+    for (int j = j_start; j < j_end; ++j) {
+        term *= (a - j) / (b + j) * ratio;
+        sum += term;
+    }
+    return sum;
+}
+
+#ifdef FILTER_MODEL_X86_SIMD
+
+// exp(x) = 2^n * exp(r) with n = round(x / ln(2)) and |r| <= ln(2) / 2. exp(r) is a degree 12
+// Taylor polynomial, accurate to a few ulp on that range.
+const double LOG2_E = 1.4426950408889634;
+const double LN_2_HI = 6.93145751953125e-1;
+const double LN_2_LO = 1.42860682030941723212e-6;
+const double EXP_COEFFICIENTS[] = {1.0 / 479001600.0, 1.0 / 39916800.0, 1.0 / 3628800.0,
+                                   1.0 / 362880.0,    1.0 / 40320.0,    1.0 / 5040.0,
+                                   1.0 / 720.0,       1.0 / 120.0,      1.0 / 24.0,
+                                   1.0 / 6.0,         1.0 / 2.0,        1.0,
+                                   1.0};
+
+__attribute__((target("avx2,fma"))) inline __m256d avx2_exp(__m256d x) {
+    __m256d n = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(LOG2_E)),
+                                _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256d r = _mm256_fnmadd_pd(n, _mm256_set1_pd(LN_2_HI), x);
+    r = _mm256_fnmadd_pd(n, _mm256_set1_pd(LN_2_LO), r);
+
+    __m256d p = _mm256_set1_pd(EXP_COEFFICIENTS[0]);
+    for (int i = 1; i < 13; ++i) {
+        p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(EXP_COEFFICIENTS[i]));
+    }
+
+    // 2^n built directly in the exponent bits.
+    __m256i exponent = _mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(n));
+    exponent = _mm256_slli_epi64(_mm256_add_epi64(exponent, _mm256_set1_epi64x(1023)), 52);
+    return _mm256_mul_pd(p, _mm256_castsi256_pd(exponent));
+}
+
+__attribute__((target("avx2,fma"))) double avx2_max(const double *x, int count) {
+    __m256d max = _mm256_set1_pd(-INFINITY);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        max = _mm256_max_pd(max, _mm256_loadu_pd(x + i));
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, max);
+    return std::max(scalar_max(lanes, 4), scalar_max(x + i, count - i));
+}
+
+__attribute__((target("avx2,fma"))) double avx2_sum_exp(const double *x, int count,
+                                                         double shift) {
+    const __m256d shift_v = _mm256_set1_pd(shift);
+    const __m256d min_v = _mm256_set1_pd(MIN_SHIFTED_EXPONENT);
+    __m256d sum = _mm256_setzero_pd();
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256d shifted = _mm256_sub_pd(_mm256_loadu_pd(x + i), shift_v);
+        __m256d in_range = _mm256_cmp_pd(shifted, min_v, _CMP_GE_OQ);
+        __m256d e = avx2_exp(_mm256_max_pd(shifted, min_v));
+        sum = _mm256_add_pd(sum, _mm256_and_pd(e, in_range));
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, sum);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + scalar_sum_exp(x + i, count - i, shift);
+}
+
+// Lane l starts at the term after the first l + 1 ratios and then takes four ratios at a time,
+// as one quotient (a - j)...(a - j - 3) / ((b + j)...(b + j + 3)) times ratio^4.
+__attribute__((target("avx2,fma"))) double avx2_walk_sum(double a, double b, double ratio,
+                                                          int count) {
+    const double ratio_4 = ratio * ratio * ratio * ratio;
+    // Shorter walks are faster in scalar code.
+    if (count < 16 || !std::isnormal(ratio_4)) {
+        return scalar_walk_sum(a, b, ratio, 0, count, 1.0);
+    }
+    double lanes[4];
+    double term = 1.0;
+    for (int j = 0; j < 4; ++j) {
+        term *= (a - j) / (b + j) * ratio;
+        lanes[j] = term;
+    }
+
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256d four = _mm256_set1_pd(4.0);
+    const __m256d a_v = _mm256_set1_pd(a);
+    const __m256d b_v = _mm256_set1_pd(b);
+    const __m256d ratio_4_v = _mm256_set1_pd(ratio_4);
+    __m256d terms = _mm256_loadu_pd(lanes);
+    __m256d sum = terms;
+    __m256d j = _mm256_setr_pd(1.0, 2.0, 3.0, 4.0);
+    int done = 4;
+    for (; done + 4 <= count; done += 4) {
+        __m256d numerator_factor = _mm256_sub_pd(a_v, j);
+        __m256d denominator_factor = _mm256_add_pd(b_v, j);
+        __m256d numerator = numerator_factor;
+        __m256d denominator = denominator_factor;
+        for (int step = 1; step < 4; ++step) {
+            numerator_factor = _mm256_sub_pd(numerator_factor, one);
+            denominator_factor = _mm256_add_pd(denominator_factor, one);
+            numerator = _mm256_mul_pd(numerator, numerator_factor);
+            denominator = _mm256_mul_pd(denominator, denominator_factor);
+        }
+        terms = _mm256_mul_pd(terms,
+                              _mm256_mul_pd(_mm256_div_pd(numerator, denominator), ratio_4_v));
+        sum = _mm256_add_pd(sum, terms);
+        j = _mm256_add_pd(j, four);
+    }
+
+    _mm256_storeu_pd(lanes, terms);
+    double tail = scalar_walk_sum(a, b, ratio, done, count, lanes[3]);
+    _mm256_storeu_pd(lanes, sum);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + tail;
+}
+
+__attribute__((target("avx512f"))) inline __m512d avx512_exp(__m512d x) {
+    __m512d n = _mm512_roundscale_pd(_mm512_mul_pd(x, _mm512_set1_pd(LOG2_E)),
+                                     _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m512d r = _mm512_fnmadd_pd(n, _mm512_set1_pd(LN_2_HI), x);
+    r = _mm512_fnmadd_pd(n, _mm512_set1_pd(LN_2_LO), r);
+
+    __m512d p = _mm512_set1_pd(EXP_COEFFICIENTS[0]);
+    for (int i = 1; i < 13; ++i) {
+        p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(EXP_COEFFICIENTS[i]));
+    }
+    return _mm512_scalef_pd(p, n);
+}
+
+__attribute__((target("avx512f"))) double avx512_max(const double *x, int count) {
+    __m512d max = _mm512_set1_pd(-INFINITY);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        max = _mm512_max_pd(max, _mm512_loadu_pd(x + i));
+    }
+    return std::max(_mm512_reduce_max_pd(max), scalar_max(x + i, count - i));
+}
+
+__attribute__((target("avx512f"))) double avx512_sum_exp(const double *x, int count,
+                                                          double shift) {
+    const __m512d shift_v = _mm512_set1_pd(shift);
+    const __m512d min_v = _mm512_set1_pd(MIN_SHIFTED_EXPONENT);
+    __m512d sum = _mm512_setzero_pd();
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m512d shifted = _mm512_sub_pd(_mm512_loadu_pd(x + i), shift_v);
+        __mmask8 in_range = _mm512_cmp_pd_mask(shifted, min_v, _CMP_GE_OQ);
+        sum = _mm512_mask_add_pd(sum, in_range, sum, avx512_exp(shifted));
+    }
+    return _mm512_reduce_add_pd(sum) + scalar_sum_exp(x + i, count - i, shift);
+}
+
+#endif
+
+double max_of(const double *x, int count, MultinomialBatch::InstructionSet instruction_set) {
+#ifdef FILTER_MODEL_X86_SIMD
+    switch (instruction_set) {
+        case MultinomialBatch::InstructionSet::AVX512:
+            return avx512_max(x, count);
+        case MultinomialBatch::InstructionSet::AVX2:
+            return avx2_max(x, count);
+        default:
+            break;
+    }
+#endif
+    return scalar_max(x, count);
+}
+
+double sum_exp(const double *x, int count, double shift,
+               MultinomialBatch::InstructionSet instruction_set) {
+#ifdef FILTER_MODEL_X86_SIMD
+    switch (instruction_set) {
+        case MultinomialBatch::InstructionSet::AVX512:
+            return avx512_sum_exp(x, count, shift);
+        case MultinomialBatch::InstructionSet::AVX2:
+            return avx2_sum_exp(x, count, shift);
+        default:
+            break;
+    }
+#endif
+    return scalar_sum_exp(x, count, shift);
+}
+
+double walk_sum_of(double a, double b, double ratio, int count,
+                   MultinomialBatch::InstructionSet instruction_set) {
+#ifdef FILTER_MODEL_X86_SIMD
+    switch (instruction_set) {
+        // Eight lanes need a product of eight ratios per step, which measured slower than four.
+        case MultinomialBatch::InstructionSet::AVX512:
+        case MultinomialBatch::InstructionSet::AVX2:
+            return avx2_walk_sum(a, b, ratio, count);
+        default:
+            break;
+    }
+#endif
+    return scalar_walk_sum(a, b, ratio, 0, count, 1.0);
+}
+
+}  // namespace
+
+MultinomialBatch::InstructionSet MultinomialBatch::detected_instruction_set() {
+    static const InstructionSet detected = []() {
+#ifdef FILTER_MODEL_X86_SIMD
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f")) {
+            return InstructionSet::AVX512;
+        }
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+            return InstructionSet::AVX2;
+        }
+#endif
+        return InstructionSet::SCALAR;
+    }();
+    return detected;
+}
+
+double MultinomialBatch::log_sum_exp(const double *log_terms, int count,
+                                     InstructionSet instruction_set) {
+    double max = max_of(log_terms, count, instruction_set);
+    if (max == -INFINITY) {
+        return -INFINITY;
+    }
+    return max + std::log(sum_exp(log_terms, count, max, instruction_set));
+}
+
+double MultinomialBatch::log_sum_row(const Multinomial &m, int k_1, int k_2_start, int k_2_end,
+                                     InstructionSet instruction_set) {
+    return log_sum_row(m, &k_1, k_2_start, k_2_end, instruction_set);
+}
+
+double MultinomialBatch::log_sum_row(const Multinomial &m, const int *k_prefix, int k_start,
+                                     int k_end, InstructionSet instruction_set) {
+    const int dimensions = m.p.size();
+    const int last = dimensions - 1;
+    const int varying = dimensions - 2;
+
+    // log_pdf({k_prefix, k, row_n - k}) = offset + k * slope - log(k!) - log((row_n - k)!)
+    int row_n = m.n;
+    double offset = m.log_adjust + LogFactorial::log_factorial(m.n);
+    for (int i = 0; i < varying; ++i) {
+        row_n -= k_prefix[i];
+        offset += k_prefix[i] * m.log_p[i] - LogFactorial::log_factorial(k_prefix[i]);
+    }
+    offset += row_n * m.log_p[last];
+    const double slope = m.log_p[varying] - m.log_p[last];
+
+    double log_terms[BLOCK_SIZE];
+    LogSumExp<true> log_row_sum;
+    for (int block_start = k_start; block_start <= k_end; block_start += BLOCK_SIZE) {
+        int count = std::min(BLOCK_SIZE, k_end - block_start + 1);
+        for (int i = 0; i < count; ++i) {
+            int k = block_start + i;
+            log_terms[i] = offset + k * slope - LogFactorial::log_factorial(k) -
+                           LogFactorial::log_factorial(row_n - k);
+        }
+        log_row_sum.add(log_sum_exp(log_terms, count, instruction_set));
+    }
+    return log_row_sum.result();
+}
+
+double MultinomialBatch::walk_sum(double a, double b, double ratio, int count,
+                                  InstructionSet instruction_set) {
+    return walk_sum_of(a, b, ratio, count, instruction_set);
+}
+
+}  // namespace FilterModel
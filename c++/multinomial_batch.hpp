@@ -0,0 +1,62 @@
+#ifndef MULTINOMIAL_BATCH_HPP
+#define MULTINOMIAL_BATCH_HPP
+
+/**
+ * Contains batch kernels that evaluate many multinomial terms at once, using SIMD instructions
+ * when the CPU supports them.
+ */
+
+#include "multinomial.hpp"
+
+namespace FilterModel {
+class MultinomialBatch {
+   public:
+    enum class InstructionSet { SCALAR, AVX2, AVX512 };
+
+    /**
+     * Returns the widest instruction set that both this build and the current CPU support. This
+     * is detected once and then cached.
+     */
+    static InstructionSet detected_instruction_set();
+
+    /**
+     * Calculates log(sum_i exp(log_terms[i])) over count terms.
+     */
+    static double log_sum_exp(const double *log_terms, int count,
+                              InstructionSet instruction_set = detected_instruction_set());
+
+    /**
+     * Calculates log of the sum of m.pdf({k_1, k_2, m.n - k_1 - k_2}) over k_2 in
+     * [k_2_start, k_2_end] for a three category multinomial m. Every k must be valid for m.
+     *
+     * Returns -INFINITY for an empty row.
+     */
+    static double log_sum_row(const Multinomial &m, int k_1, int k_2_start, int k_2_end,
+                              InstructionSet instruction_set = detected_instruction_set());
+
+    /**
+     * Calculates log of the sum of m.pdf({k_prefix, k, m.n - sum(k_prefix) - k}) over k in
+     * [k_start, k_end] for a multinomial m with at least two categories. k_prefix holds the first
+     * m.p.size() - 2 components. Every k must be valid for m.
+     *
+     * Returns -INFINITY for an empty row.
+     */
+    static double log_sum_row(const Multinomial &m, const int *k_prefix, int k_start, int k_end,
+                              InstructionSet instruction_set = detected_instruction_set());
+
+    /**
+     * Calculates the sum over m in [1, count] of the product over j in [0, m) of
+     * (a - j) / (b + j) * ratio. With a = row_n - k, b = k + 1 and ratio = p_2 / p_3 these are the
+     * terms of the row {k_1, k_2, row_n - k_2} at k_2 = k + 1, ..., k + count relative to the term
+     * at k_2 = k, which is how the row walk of calculate_log_sum_over_k_negative_incremental
+     * proceeds. count must be at most a + 1 so every factor is non negative.
+     *
+     * With AVX2 each of four lanes advances by the product of four neighbouring ratios at a time,
+     * so the terms are no longer one serial chain of multiplications.
+     */
+    static double walk_sum(double a, double b, double ratio, int count,
+                           InstructionSet instruction_set = detected_instruction_set());
+};
+}  // namespace FilterModel
+
+#endif
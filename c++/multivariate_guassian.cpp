@@ -4,6 +4,8 @@
 #include "utils.hpp"
 
 #include <Eigen/Dense>
+#include <cmath>
+#include <random>
 #include <vector>
 
 namespace FilterModel {
@@ -23,7 +25,13 @@ MultivariateGuassian::MultivariateGuassian(const std::vector<double> mean_in,
         }
     }
 
-    covariance_inverse = covariance.inverse();
+    cholesky.compute(covariance);
+    if (cholesky.info() != Eigen::Success) {
+        BOOST_LOG_TRIVIAL(fatal) << "MultivariateGuassian covariance must be positive definite.";
+        assert(false);
+    }
+    double log_determinant = 2 * cholesky.matrixLLT().diagonal().array().log().sum();
+    log_normalizer = -0.5 * (mean.size() * std::log(2 * M_PI) + log_determinant);
 };
 
 MultivariateGuassian MultivariateGuassian::from_multinomial(int n, const std::vector<double>& p) {
@@ -53,25 +61,38 @@ MultivariateGuassian MultivariateGuassian::from_multinomial(const Multinomial& m
     return MultivariateGuassian::from_multinomial(m.n, new_p);
 }
 
-double MultivariateGuassian::density(std::vector<double> point) const {
+double MultivariateGuassian::density(const std::vector<double>& point) const {
+    return std::exp(log_density(point));
+}
+
+double MultivariateGuassian::log_density(const std::vector<double>& point) const {
     if (point.size() != mean.size()) {
         BOOST_LOG_TRIVIAL(fatal) << "MultivariateGuassian density input must have the same number "
                                     "of dimensions as the distribution.";
         assert(false);
     }
+    return log_density_batch(Eigen::Map<const Eigen::VectorXd>(point.data(), point.size()))[0];
+}
 
-    // TODO(joschnei): There has to be a better way to do this copy.
-    Eigen::VectorXd x(point.size());
-    for (int i = 0; i < point.size(); ++i) {
-        x[i] = point.at(i);
-    }
+Eigen::VectorXd MultivariateGuassian::log_density_batch(
+    const Eigen::Ref<const Eigen::MatrixXd>& points) const {
+    assert(points.rows() == mean.size());
+    Eigen::MatrixXd whitened = points.colwise() - mean;
+    cholesky.matrixL().solveInPlace(whitened);
+    return (log_normalizer - 0.5 * whitened.colwise().squaredNorm().array()).matrix().transpose();
+}
 
-    Eigen::VectorXd diff = (x - mean).eval();
-    Eigen::RowVectorXd mult1 = (diff.transpose() * covariance_inverse).eval();
-    double mult2 = (mult1 * diff).eval()(0, 0);
-    double det = covariance.determinant();
-    double val = std::exp(-1.0 / 2.0 * mult2) / std::sqrt(std::pow(2 * M_PI, mean.size()) * det);
-    return val;
+Eigen::MatrixXd MultivariateGuassian::sample_batch(std::default_random_engine& generator,
+                                                   int n_points) const {
+    std::normal_distribution<double> standard_normal;
+    Eigen::MatrixXd points(mean.size(), n_points);
+    for (int j = 0; j < n_points; ++j) {
+        for (int i = 0; i < mean.size(); ++i) {
+            points(i, j) = standard_normal(generator);
+        }
+    }
+    points = cholesky.matrixL() * points;
+    return points.colwise() + mean;
 }
 
 void MultivariateGuassian::shift_hyperplanes(std::vector<std::vector<double>>& hyperplanes) {
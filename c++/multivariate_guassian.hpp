@@ -7,6 +7,7 @@
 
 #include <Eigen/Dense>
 #include <boost/log/trivial.hpp>
+#include <random>
 #include <vector>
 
 namespace FilterModel {
@@ -34,12 +35,30 @@ class MultivariateGuassian {
     std::vector<double> get_mean() const;
 
     void shift_hyperplanes(std::vector<std::vector<double>>& hyperplanes);
-    double density(std::vector<double> point) const;
+    double density(const std::vector<double>& point) const;
+    double log_density(const std::vector<double>& point) const;
+
+    /**
+     * Returns the log density of every column of points, a dimensions x n matrix.
+     *
+     * The columns are centred and whitened together with one triangular solve against the
+     * cholesky factor, so large batches cost about as much as reading the points.
+     */
+    Eigen::VectorXd log_density_batch(const Eigen::Ref<const Eigen::MatrixXd>& points) const;
+
+    /**
+     * Draws n_points points from the guassian, returned as the columns of a dimensions x n_points
+     * matrix.
+     */
+    Eigen::MatrixXd sample_batch(std::default_random_engine& generator, int n_points) const;
 
    private:
     Eigen::VectorXd mean;
     Eigen::MatrixXd covariance;
-    Eigen::MatrixXd covariance_inverse;
+    // covariance = L L^T, computed once so densities need only a triangular solve.
+    Eigen::LLT<Eigen::MatrixXd> cholesky;
+    // -1/2 log((2 pi)^d det(covariance)).
+    double log_normalizer;
 };
 }  // namespace FilterModel
 
@@ -1,58 +1,697 @@
 #include "mvi3.hpp"
-#include <stdio.h>
-#include <unistd.h>
-#include <fstream>
-#include <string>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
 #include <vector>
 
+/**
+ * Port of mvi3.for. Fortran's default real is single precision, so every real of the original is
+ * a float here and the operations are done in the same order, which keeps the results identical
+ * to the compiled program. Comments name the Fortran routine or label each piece comes from.
+ */
+
 namespace MVI3 {
-double Mvi3::integrate(int seed, int dof, int mocar, int irep,
-                       std::vector<std::vector<double>> covariance,
-                       std::vector<std::vector<double>> hyperplanes) {
-    // Possibly wipe qcalc.out and create an empty qcalc.out
-    in_stream.open(Mvi3::OUT_FILE, std::ios::out | std::ios::trunc);
-    in_stream.close();
 
-    in_stream.open(Mvi3::IN_FILE, std::ios::out | std::ios::trunc);
+namespace {
+
+// Constants of the seeding generator (module comm).
+const int32_t MR = 714025;
+const int32_t IA = 1366;
+const int32_t IC = 150889;
+
+/**
+ * Integer arithmetic of the random number generators, which relies on 32 bit wrap around.
+ */
+inline int32_t wrap(uint32_t x) { return static_cast<int32_t>(x); }
+
+/**
+ * Marsaglia's multiply with carry step shared by rnor.
+ */
+inline void step(int32_t &z, int32_t &w) {
+    z = wrap(36969u * (uint32_t(z) & 65535u) + (uint32_t(z) >> 16));
+    w = wrap(18000u * (uint32_t(w) & 65535u) + (uint32_t(w) >> 16));
+}
+
+inline float combined(int32_t z, int32_t w) {
+    return float(wrap((uint32_t(z) << 16) + (uint32_t(w) & 65535u)));
+}
+
+/**
+ * rnor: Marsaglia's Monty Python normal generator.
+ */
+float rnor(int32_t &z, int32_t &w) {
+    const float a = 1.17741f;
+    const float b = 2.506628f;
+    const float s = .8857913f;
+
+    step(z, w);
+    float x = 1.16724e-9f * combined(z, w);
+    if (std::abs(x) < a) {
+        return x;
+    }
+    step(z, w);
+    float y = std::abs(4.656613e-10f * combined(z, w));
+    float v = 2.8658f - std::abs(x) * (2.0213f - .3605f * std::abs(x));
+    if (y < v) {
+        return x;
+    }
+    if (y > v + .0506f) {
+        return std::copysign(s * (b - std::abs(x)), x);
+    }
+    if (std::log(y) < -(.5f * (x * x)) + .6931472f) {
+        return x;
+    }
+    x = std::copysign(s * (b - std::abs(x)), x);
+    if (std::log(1.8857913f - y) < .5718733f - .5f * (x * x)) {
+        return x;
+    }
+    while (true) {
+        step(z, w);
+        v = 4.656613e-10f * combined(z, w);
+        x = -std::log(std::abs(v)) / b;
+        step(z, w);
+        y = .5f + 2.328306e-10f * combined(z, w);
+        y = -std::log(y);
+        if (!(y + y < x * x)) {
+            return std::copysign(b + x, v);
+        }
+    }
+}
+
+/**
+ * cgamma: Marsaglia's gamma generator.
+ */
+float cgamma(float a, int32_t &z, int32_t &w, int32_t &jran) {
+    float d = a - .3333333f;
+    float c = .3333333f / std::sqrt(d);
+    while (true) {
+        float x = rnor(z, w);
+        float v = 1.f + c * x;
+        if (v <= 0.f) {
+            continue;
+        }
+        v = v * v * v;
+        jran = wrap(69069u * uint32_t(jran));
+        float u = .5f + float(jran) * .2328306e-9f;
+        float x_squared = x * x;
+        if (u <= 1.f - .0331f * (x_squared * x_squared)) {
+            return d * v;
+        }
+        if (std::log(u) - .5f * x * x <= d * (1.f - v + std::log(v))) {
+            return d * v;
+        }
+    }
+}
+
+/**
+ * gammln: log of the gamma function (Numerical Recipes).
+ */
+float gammln(float xx) {
+    const float cof[6] = {76.18009173f,  -86.50532033f,   24.01409822f,
+                          -1.231739516f, .120858003e-2f, -.536382e-5f};
+    const float stp = 2.50662827465f;
+    float x = xx - 1.f;
+    float tmp = x + 5.5f;
+    tmp = (x + .5f) * std::log(tmp) - tmp;
+    float ser = 1.f;
+    for (int j = 0; j < 6; ++j) {
+        x = x + 1.f;
+        ser = ser + cof[j] / x;
+    }
+    return tmp + std::log(stp * ser);
+}
+
+const int ITMAX = 100;
+const float EPS = 3.e-7f;
+
+/**
+ * gser: series for the incomplete gamma function.
+ */
+float gser(float a, float x) {
+    float gln = gammln(a);
+    if (x <= 0.f) {
+        return 0.f;
+    }
+    float ap = a;
+    float sum = 1.f / a;
+    float del = sum;
+    for (int n = 1; n <= ITMAX; ++n) {
+        ap = ap + 1.f;
+        del = del * x / ap;
+        sum = sum + del;
+        if (std::abs(del) < std::abs(sum) * EPS) {
+            break;
+        }
+    }
+    return sum * std::exp(-x + a * std::log(x) - gln);
+}
+
+/**
+ * gcf: continued fraction for the incomplete gamma function.
+ */
+float gcf(float a, float x) {
+    float gln = gammln(a);
+    float gold = 0.f;
+    float a0 = 1.f;
+    float a1 = x;
+    float b0 = 0.f;
+    float b1 = 1.f;
+    float fac = 1.f;
+    float g = 0.f;
+    for (int n = 1; n <= ITMAX; ++n) {
+        float an = float(n);
+        float ana = an - a;
+        a0 = (a1 + a0 * ana) * fac;
+        b0 = (b1 + b0 * ana) * fac;
+        float anf = an * fac;
+        a1 = x * a0 + anf * a1;
+        b1 = x * b0 + anf * b1;
+        if (a1 != 0.f) {
+            fac = 1.f / a1;
+            g = b1 * fac;
+            if (std::abs((g - gold) / g) < EPS) {
+                break;
+            }
+            gold = g;
+        }
+    }
+    return std::exp(-x + a * std::log(x) - gln) * g;
+}
+
+/**
+ * gammp: the regularised lower incomplete gamma function P(a, x).
+ */
+float gammp(float a, float x) {
+    if (x < a + 1.f) {
+        return gser(a, x);
+    }
+    return 1.f - gcf(a, x);
+}
+
+/**
+ * pf: probabilities of the F-distribution.
+ */
+float pf(int n1, int n2, float z) {
+    if (!(z > 0.f) || !(n1 > 0 && n2 > 0)) {
+        return 0.f;
+    }
+    const float pi = float(3.141592653589793);
+    float an1 = n1;
+    float an2 = n2;
+    float a = an1 * z / (an1 * z + an2);
+    float a1 = 1.f - a;
+    if (a1 < 0.1e-36) {
+        a1 = float(0.1e-36);
+    }
+    float d1 = an1 * .5f;
+    float d2 = an2 * .5f;
+    float d3 = d1 + d2 - 1.f;
+    float r = 0.f;
+    float s1 = 0.f;
+    float s2 = 0.f;
+    float del = 1.f;
+    float xm = 1.f;
+    float xk = 1.f;
+    float cc = .25f;
+    float t = 0.f;
+    int n = n2;
+
+    auto inner_loop = [&]() {
+        for (int i = 1; i <= n; ++i) {
+            s1 = del + s1 * r;
+            d2 = d2 - 1.f;
+            d3 = d3 - 1.f;
+            float tem = a1 / d2;
+            r = d3 * tem;
+            s2 = (r + tem) * s2;
+        }
+    };
+
+    // Label 15, the major loop.
+    while (true) {
+        int m = int(d2);
+        m = 2 * m;
+        if (m == n) {
+            // Even degrees of freedom.
+            n = int(d2 - 1.f);
+            inner_loop();
+            s1 = del + s1 * r;
+            del = 0.f;
+            t = -1.f;
+            d3 = -1.f;
+            s2 = a * s2;
+            cc = cc + .5f;
+        } else {
+            // Odd degrees of freedom.
+            n = int(d2);
+            inner_loop();
+            s1 = xk * s1;
+            s2 = xk * s2;
+            float art = std::sqrt(a1);
+            xm = xm * art;
+            t = (xm - art) / a1;
+            d3 = -.5f;
+            xk = float(2.0 / double(pi));
+            cc = cc * 2.f;
+        }
+        if (cc > .875f) {
+            break;
+        }
+        d2 = d1;
+        d3 = d2 + d3;
+        s2 = s1;
+        s1 = 0.f;
+        a1 = a;
+        if (a1 < 0.1e-36) {
+            a1 = float(0.1e-36);
+        }
+        n = n1;
+    }
+    if (cc < 1.125f) {
+        del = float(4.0 / double(pi) * double(std::atan(t)));
+    }
+    float poff = xm * (s2 - s1) - del;
+    if (poff < 0.f) {
+        poff = 0.f;
+    }
+    if (poff > 1.f) {
+        poff = 1.f;
+    }
+    return poff;
+}
+
+/**
+ * Everything the Fortran program keeps in module comm for one problem.
+ */
+class Problem {
+   public:
+    Problem(int seed, int dof, int mocar, int irep,
+            const std::vector<std::vector<double>> &covariance,
+            const std::vector<std::vector<double>> &hyperplanes)
+        : k(covariance.size()),
+          mm(hyperplanes.size()),
+          ndenom(dof),
+          mocar(mocar),
+          irep(irep),
+          dc(k),
+          bound(mm, std::vector<float>(k)),
+          gd(mm, std::vector<float>(k)),
+          dmd(mm) {
+        seed_generators(seed);
+        std::vector<std::vector<float>> cmc = chol(covariance);
+        set_boundaries(hyperplanes, cmc);
+    }
+
+    Estimate run() {
+        // If the origin is not interior to the convex region use crude Monte Carlo.
+        if (ndzero > 0 || negs > 0) {
+            return crude(mocar * irep);
+        }
+        return random_directions();
+    }
+
+   private:
+    const int k;
+    const int mm;
+    const int ndenom;
+    const int mocar;
+    const int irep;
+
+    int32_t nz;
+    int32_t nw;
+    int32_t nran;
+
+    int negs = 0;
+    int ndzero = 0;
+
+    std::vector<float> dc;
+    std::vector<std::vector<float>> bound;
+    std::vector<std::vector<float>> gd;
+    std::vector<float> dmd;
+
+    void seed_generators(int seed) {
+        int32_t iseed = std::abs(seed);
+        int32_t iran[97];
+        for (int j = 0; j < 97; ++j) {
+            iseed = wrap(uint32_t(IA) * uint32_t(iseed) + uint32_t(IC)) % MR;
+            iran[j] = iseed;
+        }
+        nz = iran[26];
+        nw = iran[56];
+        nran = iran[96];
+    }
+
+    /**
+     * chol: decomposes the covariance into c times c transpose.
+     */
+    std::vector<std::vector<float>> chol(const std::vector<std::vector<double>> &covariance) {
+        // Only the lower triangle is read, as from qcalc.in.
+        std::vector<std::vector<float>> vcc(k, std::vector<float>(k));
+        for (int i = 0; i < k; ++i) {
+            for (int j = 0; j <= i; ++j) {
+                vcc[i][j] = covariance.at(i).at(j);
+                vcc[j][i] = vcc[i][j];
+            }
+        }
+
+        std::vector<std::vector<float>> cmc(k, std::vector<float>(k, 0.f));
+        std::vector<float> dd(k);
+        for (int i = 0; i < k; ++i) {
+            cmc[i][i] = 1.f;
+        }
+        for (int j = 0; j < k; ++j) {
+            dd[j] = vcc[j][j];
+            for (int ii = 0; ii < j; ++ii) {
+                dd[j] = dd[j] - cmc[j][ii] * cmc[j][ii] * dd[ii];
+            }
+            for (int i = j + 1; i < k; ++i) {
+                cmc[i][j] = vcc[i][j];
+                for (int ii = 0; ii < j; ++ii) {
+                    cmc[i][j] = cmc[i][j] - cmc[j][ii] * cmc[i][ii] * dd[ii];
+                }
+                cmc[i][j] = cmc[i][j] / dd[j];
+            }
+        }
+        for (int j = 0; j < k; ++j) {
+            float a = std::sqrt(dd[j]);
+            for (int i = j; i < k; ++i) {
+                cmc[i][j] = a * cmc[i][j];
+            }
+        }
+        return cmc;
+    }
+
+    /**
+     * Orders the boundaries as the main program does: negative right hand sides first, then zero,
+     * then positive, scaled so the right hand side is -1, 0 or 1. Then transforms them to the
+     * coordinates in which the covariance is the identity, normalises them, and sorts them from
+     * closest to farthest from the origin.
+     */
+    void set_boundaries(const std::vector<std::vector<double>> &hyperplanes,
+                        const std::vector<std::vector<float>> &cmc) {
+        std::vector<std::vector<float>> zerobnd;
+        int istart = 0;
+        int iend = mm;
+        for (int i = 0; i < mm; ++i) {
+            std::vector<float> row(k);
+            for (int j = 0; j < k; ++j) {
+                row[j] = hyperplanes.at(i).at(j);
+            }
+            float dend = hyperplanes.at(i).at(k);
+            if (dend == 0.f) {
+                ++ndzero;
+                zerobnd.push_back(row);
+                continue;
+            }
+            std::vector<float> *target;
+            if (dend > 0.f) {
+                target = &bound[--iend];
+            } else {
+                dend = -dend;
+                ++negs;
+                target = &bound[istart++];
+            }
+            for (int j = 0; j < k; ++j) {
+                (*target)[j] = row[j] / dend;
+            }
+        }
+        for (int i = 0; i < ndzero; ++i) {
+            bound[negs + i] = zerobnd[i];
+        }
+
+        // bound = matmul(bound, cmc)
+        for (int i = 0; i < mm; ++i) {
+            std::vector<float> transformed(k, 0.f);
+            for (int j = 0; j < k; ++j) {
+                for (int l = 0; l < k; ++l) {
+                    transformed[j] += bound[i][l] * cmc[l][j];
+                }
+            }
+            bound[i] = transformed;
+        }
+
+        for (int i = 0; i < mm; ++i) {
+            float norm = 0.f;
+            for (int l = 0; l < k; ++l) {
+                norm += bound[i][l] * bound[i][l];
+            }
+            norm = std::sqrt(norm);
+            dmd[i] = 1.f / norm;
+            for (int j = 0; j < k; ++j) {
+                gd[i][j] = bound[i][j] / norm;
+            }
+        }
+
+        // dmd is the distance from the origin. The sign only orders the sort.
+        for (int i = 0; i < negs; ++i) {
+            dmd[i] = -dmd[i];
+        }
+        for (int i = negs; i < negs + ndzero; ++i) {
+            dmd[i] = 0.f;
+        }
+        if (mm > 1) {
+            sortary();
+        }
+    }
+
+    /**
+     * sortary: heap sort of dmd into ascending order, rearranging the rows of gd to match. Kept
+     * as the original heap sort so that ties end up in the same order.
+     */
+    void sortary() {
+        // 1-indexed accessors so the loop reads like the original.
+        auto ra = [this](int i) -> float & { return dmd[i - 1]; };
+        auto rb = [this](int i) -> std::vector<float> & { return gd[i - 1]; };
+
+        int n = mm;
+        int l = n / 2 + 1;
+        int ir = n;
+        while (true) {
+            float rra;
+            std::vector<float> rrb;
+            if (l > 1) {
+                l = l - 1;
+                rra = ra(l);
+                rrb = rb(l);
+            } else {
+                rra = ra(ir);
+                rrb = rb(ir);
+                ra(ir) = ra(1);
+                rb(ir) = rb(1);
+                ir = ir - 1;
+                if (ir == 1) {
+                    ra(1) = rra;
+                    rb(1) = rrb;
+                    return;
+                }
+            }
+            int i = l;
+            int j = l + l;
+            while (j <= ir) {
+                if (j < ir && ra(j) < ra(j + 1)) {
+                    j = j + 1;
+                }
+                if (rra < ra(j)) {
+                    ra(i) = ra(j);
+                    rb(i) = rb(j);
+                    i = j;
+                    j = j + j;
+                } else {
+                    j = ir + 1;
+                }
+            }
+            ra(i) = rra;
+            rb(i) = rrb;
+        }
+    }
+
+    /**
+     * racos: direction cosines of a random direction.
+     */
+    void racos() {
+        float sum = 0.f;
+        for (int i = 0; i < k; ++i) {
+            dc[i] = rnor(nz, nw);
+            sum = sum + dc[i] * dc[i];
+        }
+        sum = std::sqrt(sum);
+        for (int i = 0; i < k; ++i) {
+            dc[i] = dc[i] / sum;
+        }
+    }
 
-    // Writes header line.
-    in_stream << std::to_string(covariance.size()) << " " << std::to_string(seed) << " "
-              << std::to_string(dof) << " " << std::to_string(mocar) << " " << std::to_string(irep)
-              << " " << std::to_string(hyperplanes.size()) << std::endl;
+    /**
+     * mvidist: reciprocal distances from the origin to the boundary along dc and -dc.
+     */
+    void mvidist(float &dis1, float &dis2) const {
+        dis1 = 0.f;
+        dis2 = 0.f;
+        for (int i = 0; i < mm; ++i) {
+            float a = 0.f;
+            for (int j = 0; j < k; ++j) {
+                a = a + dc[j] * gd[i][j];
+            }
+            a = a / dmd[i];
+            if (a < 0.f) {
+                dis1 = std::min(a, dis1);
+            } else {
+                dis2 = std::max(a, dis2);
+            }
+        }
+        dis1 = -dis1;
+    }
 
-    for (int row = 0; row < covariance.size(); ++row) {
-        for (int column = 0; column <= row; ++column) {
-            in_stream << std::to_string(covariance.at(row).at(column)) << " ";
+    /**
+     * Probability mass beyond reciprocal distance dis along a direction (loops 600 and 610).
+     */
+    float mass_beyond(float dis) const {
+        if (dis == 0.f) {
+            return 1.f;
+        }
+        const float zm = k;
+        if (ndenom > 0) {
+            float qsphere = zm * dis * dis;
+            qsphere = 1.f / qsphere;
+            return pf(k, ndenom, qsphere);
         }
-        in_stream << std::endl;
+        float qsphere = dis * dis * 2.f;
+        qsphere = 1.f / qsphere;
+        return gammp(zm / 2.f, qsphere);
     }
 
-    for (std::vector<double> hyperplane : hyperplanes) {
-        for (double coeff : hyperplane) {
-            in_stream << std::to_string(coeff) << " ";
+    /**
+     * Main loop of the program (labels 580 to 902): averages irep estimates of mocar random
+     * directions each.
+     */
+    Estimate random_directions() {
+        float sx = 0.f;
+        float ssx = 0.f;
+        float cc = 0.f;
+        const float zrep = irep;
+        for (int njj = 0; njj < irep; ++njj) {
+            float sum = 0.f;
+            // With ndenom == 0 the program adds nothing, which is kept as is.
+            if (ndenom != 0) {
+                for (int i = 0; i < mocar; ++i) {
+                    racos();
+                    float dis1, dis2;
+                    mvidist(dis1, dis2);
+                    sum = sum + mass_beyond(dis1);
+                    sum = sum + mass_beyond(dis2);
+                }
+            }
+            float points = float(mocar * 2);
+            float qans = sum / points;
+            if (njj == 0) {
+                cc = qans;
+            }
+            float cm = qans - cc;
+            sx = sx + cm;
+            ssx = ssx + cm * cm;
+        }
+
+        Estimate estimate;
+        estimate.standard_error = std::numeric_limits<double>::quiet_NaN();
+        if (zrep != 1.f) {
+            float sd = (ssx - sx * sx / zrep) / (zrep - 1.f);
+            estimate.standard_error = std::sqrt(sd / zrep);
         }
-        in_stream << std::endl;
+        estimate.value = sx / zrep + cc;
+        return estimate;
     }
 
-    in_stream << "-1 -1 -1 -1 -1 -1" << std::endl;
-    in_stream.close();
+    /**
+     * normpt and tpoint2: a random normal or multivariate t point.
+     */
+    void random_point() {
+        for (int i = 0; i < k; ++i) {
+            dc[i] = rnor(nz, nw);
+        }
+        if (ndenom >= 0) {
+            const float zn = ndenom;
+            float ch = 2.f * cgamma(zn / 2.f, nz, nw, nran);
+            ch = std::sqrt(ch / zn);
+            for (int i = 0; i < k; ++i) {
+                dc[i] = dc[i] / ch;
+            }
+        }
+    }
 
-    int ignored = chdir("c++/mvi3/build/");
-    ignored = system("./mvi3 2>&1 >/dev/null");
-    ignored = chdir("../../..");
+    /**
+     * ranpnt: left hand side of boundary iee at dc.
+     */
+    float ranpnt(int iee) const {
+        float sum = 0.f;
+        for (int j = 0; j < k; ++j) {
+            sum = sum + bound[iee][j] * dc[j];
+        }
+        return sum;
+    }
 
-    out_stream.open(Mvi3::OUT_FILE, std::ios::in);
-    std::string line;
-    while (getline(out_stream, line)) {
-        for (std::string target_line : TARGET_LINES) {
-            if (line.substr(0, target_line.size()) == target_line) {
-                out_stream.close();
-                return stod(line.substr(line.find_first_of("0123456789"), line.size()));
+    bool inside() const {
+        for (int iee = 0; iee < negs; ++iee) {
+            if (ranpnt(iee) > -1.f) {
+                return false;
+            }
+        }
+        for (int iee = negs; iee < negs + ndzero; ++iee) {
+            if (ranpnt(iee) > 0.f) {
+                return false;
             }
         }
+        for (int iee = negs + ndzero; iee < mm; ++iee) {
+            if (ranpnt(iee) > 1.f) {
+                return false;
+            }
+        }
+        return true;
     }
 
-    // Should never happen.
-    return -1.0;
+    /**
+     * crude: crude Monte Carlo with each random point and its reflection.
+     */
+    Estimate crude(int n_points) {
+        float zin = 0.f;
+        for (int ijk = 0; ijk < n_points; ++ijk) {
+            random_point();
+            if (inside()) {
+                zin = zin + 1.f;
+                // By symmetry the reflection can't also be inside when the origin isn't interior.
+                if (negs > 0 || ndzero > 0) {
+                    continue;
+                }
+            }
+            for (float &x : dc) {
+                x = -x;
+            }
+            if (inside()) {
+                zin = zin + 1.f;
+            }
+        }
+        float points = 2.f * n_points;
+        float prob = zin / points;
+
+        Estimate estimate;
+        estimate.value = prob;
+        estimate.standard_error = std::sqrt(prob * (1.f - prob) / points);
+        return estimate;
+    }
 };
-};  // namespace MVI3
\ No newline at end of file
+
+}  // namespace
+
+Estimate Mvi3::estimate(int seed, int dof, int mocar, int irep,
+                        const std::vector<std::vector<double>> &covariance,
+                        const std::vector<std::vector<double>> &hyperplanes) const {
+    return Problem(seed, dof, mocar, irep, covariance, hyperplanes).run();
+}
+
+double Mvi3::integrate(int seed, int dof, int mocar, int irep,
+                       const std::vector<std::vector<double>> &covariance,
+                       const std::vector<std::vector<double>> &hyperplanes) const {
+    return estimate(seed, dof, mocar, irep, covariance, hyperplanes).value;
+}
+}  // namespace MVI3
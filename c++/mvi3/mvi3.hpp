@@ -1,11 +1,20 @@
 #ifndef MVI3_HPP
 #define MVI3_HPP
 
-#include <fstream>
-#include <string>
 #include <vector>
 
 namespace MVI3 {
+
+/**
+ * An estimate of an integral together with its standard error.
+ */
+struct Estimate {
+    double value;
+    // NaN when there is nothing to estimate it from, i.e. a single repetition (irep = 1) of the
+    // random directions method.
+    double standard_error;
+};
+
 class Mvi3 {
    public:
     /**
@@ -17,18 +26,24 @@ class Mvi3 {
      * covariance: A diagonal matrix of guassian covariances
      * hyperplanes: A rectangular matrix containing linear equations specifying hyperplanes of the
      *   form x1 + x2 + ... xk <= y.
+     *
+     * This is a C++ port of Somerville's MVI3 Fortran program (mvi3.for), so it runs in process
+     * and may be called from several threads at once. It keeps the program's single precision
+     * arithmetic and random number generators, so a given seed reproduces the program's output.
+     * Only the random directions and crude Monte Carlo methods are ported; the binning method was
+     * never selected by this interface.
      */
-    double integrate(int seed, int dof, int mocar, int irep, std::vector<std::vector<double>> covariance,
-                     std::vector<std::vector<double>> hyperplanes);
+    Estimate estimate(int seed, int dof, int mocar, int irep,
+                      const std::vector<std::vector<double>> &covariance,
+                      const std::vector<std::vector<double>> &hyperplanes) const;
 
-   private:
-    const std::string IN_FILE = "c++/mvi3/build/qcalc.in";
-    std::ofstream in_stream;
-    const std::string OUT_FILE = "c++/mvi3/build/qcalc.out";
-    std::ifstream out_stream;
-    const std::string EXECUTABLE_PATH = "mvi3/build/mvi3";
-    std::vector<std::string> TARGET_LINES = {" mean value is", " estimate of integral is"};
+    /**
+     * Returns just the value of estimate(...).
+     */
+    double integrate(int seed, int dof, int mocar, int irep,
+                     const std::vector<std::vector<double>> &covariance,
+                     const std::vector<std::vector<double>> &hyperplanes) const;
 };
 }  // namespace MVI3
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,75 @@
+#ifndef PHILOX_HPP
+#define PHILOX_HPP
+
+/**
+ * Contains the Philox4x32-10 counter based random number generator of Salmon et al., "Parallel
+ * random numbers: as easy as 1, 2, 3" (SC 2011).
+ */
+
+#include <array>
+#include <cstdint>
+#include <limits>
+
+namespace FilterModel {
+
+/**
+ * A random number generator whose output is a fixed function of a key and a counter, so any
+ * number of independent streams can be opened from a seed and a stream index without any shared
+ * state. Draws made by different threads on their own streams are then the same whatever the
+ * threads or their order.
+ *
+ * Meets the UniformRandomBitGenerator requirements, so it works with the standard
+ * distributions.
+ */
+class Philox4x32 {
+   public:
+    typedef uint32_t result_type;
+    typedef std::array<uint32_t, 4> counter_t;
+    typedef std::array<uint32_t, 2> key_t;
+
+    /**
+     * Opens the stream (seed, stream, substream), for example (seed, iteration, object).
+     */
+    Philox4x32(uint64_t seed, uint64_t stream, uint32_t substream = 0)
+        : key{{uint32_t(seed), uint32_t(seed >> 32)}},
+          counter{{0, substream, uint32_t(stream), uint32_t(stream >> 32)}} {}
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+    result_type operator()() {
+        if (used == 4) {
+            output = block(counter, key);
+            ++counter[0];
+            used = 0;
+        }
+        return output[used++];
+    }
+
+    /**
+     * Returns the four words for the given counter and key.
+     */
+    static counter_t block(counter_t counter, key_t key) {
+        for (int round = 0; round < 10; ++round) {
+            if (round > 0) {
+                key[0] += 0x9E3779B9;
+                key[1] += 0xBB67AE85;
+            }
+            uint64_t product_0 = uint64_t(0xD2511F53) * counter[0];
+            uint64_t product_1 = uint64_t(0xCD9E8D57) * counter[2];
+            counter = {{uint32_t(product_1 >> 32) ^ counter[1] ^ key[0], uint32_t(product_1),
+                        uint32_t(product_0 >> 32) ^ counter[3] ^ key[1], uint32_t(product_0)}};
+        }
+        return counter;
+    }
+
+   private:
+    const key_t key;
+    // Word 0 counts the blocks drawn; the rest name the stream.
+    counter_t counter;
+    counter_t output;
+    int used = 4;
+};
+}  // namespace FilterModel
+
+#endif
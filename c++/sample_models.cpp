@@ -1,11 +1,15 @@
 #include "sample_models.hpp"
 
+#include "log_sum_exp.hpp"
 #include "model_distribution.hpp"
+#include "philox.hpp"
+#include "thread_pool.hpp"
 #include "types.hpp"
 #include "utils.hpp"
 
 #include <algorithm>
 #include <boost/log/trivial.hpp>
+#include <functional>
 #include <random>
 #include <unordered_map>
 #include <utility>
@@ -13,33 +17,34 @@
 
 namespace FilterModel {
 
-ModelSampler::ModelSampler(const std::vector<category_counts_t> &data,
-                           std::default_random_engine &generator, const Options &options)
-    : model_distribution(data, generator, options),
-      generator(generator),
-      alphas(ModelSampler::generate_alphas(data.at(0).size(), options)),
+ModelSampler::ModelSampler(const std::vector<category_counts_t> &data, uint64_t seed,
+                           const Options &options)
+    : model_distribution(data, options),
       n_objects(data.size()),
-      n_categories(data.at(0).size()){};
-
-std::vector<alpha_t> ModelSampler::sample(double epsilon, const delta_t &delta) {
-    std::vector<double> priors(alphas.size(), 1.0 / alphas.size());
+      n_categories(data.at(0).size()),
+      alphas(ModelSampler::generate_alphas(data.at(0).size(), options)),
+      seed(seed){};
 
+std::vector<alpha_t> ModelSampler::sample(double epsilon, const delta_t &delta,
+                                          std::vector<double> *log_likelyhoods) {
     std::vector<std::vector<double>> log_alpha_likelyhoods =
         model_distribution.distribution(alphas, epsilon, delta);
 
-    std::vector<alpha_t> models;
-    for (int object_index = 0; object_index < n_objects; ++object_index) {
+    // Each object only writes its own slot and draws from its own stream.
+    std::vector<int> alpha_indices(n_objects);
+    std::function<void(int)> sample_object = [this, &log_alpha_likelyhoods,
+                                              &alpha_indices](int object_index) {
         std::vector<double> alpha_weights(alphas.size(), 0.0);
-        double total_weight = 0.0;
+        LogSumExp<> log_total_weight;
         for (int i = 0; i < alphas.size(); ++i) {
             alpha_weights.at(i) = log_alpha_likelyhoods.at(object_index).at(i);
             // check that log_alpha_likelyhoods is sane.
             // shouldn't be uniform.
-            total_weight += std::exp(alpha_weights.at(i));
+            log_total_weight.add(alpha_weights.at(i));
         }
 
         for (int i = 0; i < alphas.size(); ++i) {
-            alpha_weights.at(i) -= std::log(total_weight);
+            alpha_weights.at(i) -= log_total_weight.result();
         }
 
         std::vector<double> probabilities = exp(alpha_weights);
@@ -48,6 +53,7 @@ std::vector<alpha_t> ModelSampler::sample(double epsilon, const delta_t &delta)
         // look at probabilities
 
         // Select an alpha at random for the current object.
+        Philox4x32 generator(seed, iteration, object_index);
         std::uniform_real_distribution<double> distribution(0.0, 1.0);
         double random = distribution(generator);
         double probability_sum = 0.0;
@@ -56,13 +62,35 @@ std::vector<alpha_t> ModelSampler::sample(double epsilon, const delta_t &delta)
             probability_sum += probabilities.at(i);
             ++i;
         }
-        models.push_back(alphas.at(i - 1));
+        alpha_indices.at(object_index) = i - 1;
+    };
+    ThreadPool *thread_pool = model_distribution.get_thread_pool();
+    if (thread_pool) {
+        thread_pool->parallel_for(n_objects, sample_object);
+    } else {
+        for (int object_index = 0; object_index < n_objects; ++object_index) {
+            sample_object(object_index);
+        }
+    }
+    ++iteration;
+
+    std::vector<alpha_t> models;
+    if (log_likelyhoods != nullptr) {
+        log_likelyhoods->clear();
+    }
+    for (int object_index = 0; object_index < n_objects; ++object_index) {
+        models.push_back(alphas.at(alpha_indices.at(object_index)));
+        if (log_likelyhoods != nullptr) {
+            log_likelyhoods->push_back(
+                log_alpha_likelyhoods.at(object_index).at(alpha_indices.at(object_index)));
+        }
     }
     return models;
 };
 
 std::vector<alpha_t> ModelSampler::generate_alphas(int n_categories, const Options &options) {
-    if (options.use_smaller_alphas) {
+    // The smaller alpha set was picked for three category data.
+    if (options.use_smaller_alphas && n_categories == 3) {
         return generate_real_alphas();
     } else {
         return generate_all_alphas(n_categories);
@@ -70,18 +98,12 @@ std::vector<alpha_t> ModelSampler::generate_alphas(int n_categories, const Optio
 }
 
 std::vector<alpha_t> ModelSampler::generate_all_alphas(int n_categories) {
-    alpha_t current = std::vector<category_t>(n_categories, 0);
+    // Every non-empty subset of the categories, counting up in binary with category 0 as the
+    // lowest bit.
+    assert(n_categories < alpha_t::MAX_SIZE);
     std::vector<alpha_t> alphas;
-    alpha_t end = std::vector<category_t>(n_categories, 1);
-    while (current != end) {
-        current = alpha_t(current);
-        int i = 0;
-        while (current.at(i) == 1) {
-            current.at(i) = 0;
-            ++i;
-        }
-        current.at(i) = 1;
-        alphas.push_back(current);
+    for (alpha_t::bits_t bits = 1; bits < (alpha_t::bits_t(1) << n_categories); ++bits) {
+        alphas.push_back(alpha_t::from_bits(bits, n_categories));
     }
     return alphas;
 }
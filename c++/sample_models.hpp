@@ -6,6 +6,7 @@
 #include "types.hpp"
 
 #include <algorithm>
+#include <cstdint>
 #include <numeric>
 #include <unordered_map>
 #include <utility>
@@ -14,19 +15,29 @@
 namespace FilterModel {
 /**
  * MH Sampler for object alphas using the latent variable model in Perkins et. al.
+ *
+ * Each object's alpha is drawn from its own Philox4x32 stream keyed by (seed, call, object), on
+ * the likelyhood's thread pool, so the samples only depend on the seed and not on the number of
+ * threads.
  */
 class ModelSampler {
    public:
     /**
      * Constructs a ModelSampler from the category counts.
      */
-    ModelSampler(const std::vector<category_counts_t> &data, std::default_random_engine &generator,
+    ModelSampler(const std::vector<category_counts_t> &data, uint64_t seed,
                  const Options &options);
 
     /**
      * Samples an alpha for each object in the data given the epsilon and delta parameters.
+     *
+     * log_likelyhoods: If not null, set to log(p(k | alpha, epsilon, delta)) of each object's
+     *   sampled alpha, taken from the table the sample was drawn from.
      */
-    std::vector<alpha_t> sample(double epsilon, const delta_t &delta);
+    std::vector<alpha_t> sample(double epsilon, const delta_t &delta,
+                                std::vector<double> *log_likelyhoods = nullptr);
+
+    const ModelDistribution &get_model_distribution() const { return model_distribution; }
 
    private:
     FRIEND_TEST(generate_all_alphas, Zero);
@@ -37,7 +48,9 @@ class ModelSampler {
     const size_t n_objects;
     const size_t n_categories;
     const std::vector<alpha_t> alphas;
-    std::default_random_engine &generator;
+    const uint64_t seed;
+    // Number of calls to sample so far.
+    uint64_t iteration = 0;
 
     /**
      * Generates all possible alpha vectors of length n_categories.
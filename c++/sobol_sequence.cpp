@@ -0,0 +1,89 @@
+#include "sobol_sequence.hpp"
+
+#include <assert.h>
+#include <boost/log/trivial.hpp>
+
+namespace FilterModel {
+
+namespace {
+
+/**
+ * Primitive polynomial degree s, its coefficients a, and initial direction numbers m_1..m_s for
+ * dimensions 2 and up, from Joe and Kuo's new-joe-kuo-6.21201 table.
+ */
+struct Primitive {
+    int s;
+    uint32_t a;
+    uint32_t m[5];
+};
+
+const Primitive PRIMITIVES[SobolSequence::MAX_DIMENSIONS - 1] = {
+    {1, 0, {1}},
+    {2, 1, {1, 3}},
+    {3, 1, {1, 3, 1}},
+    {3, 2, {1, 1, 1}},
+    {4, 1, {1, 1, 3, 3}},
+    {4, 4, {1, 3, 5, 13}},
+    {5, 2, {1, 1, 5, 5, 17}},
+    {5, 4, {1, 1, 5, 5, 5}},
+    {5, 7, {1, 1, 7, 11, 19}},
+};
+
+}  // namespace
+
+SobolSequence::SobolSequence(int dimensions)
+    : n_dimensions(dimensions), directions(dimensions * BITS) {
+    if (dimensions < 0 || dimensions > MAX_DIMENSIONS) {
+        BOOST_LOG_TRIVIAL(fatal) << "SobolSequence supports between 0 and " << MAX_DIMENSIONS
+                                 << " dimensions, not " << dimensions << ".";
+        assert(false);
+    }
+
+    for (int d = 0; d < dimensions; ++d) {
+        uint32_t *v = &directions[d * BITS];
+        if (d == 0) {
+            // The van der Corput sequence.
+            for (int k = 0; k < BITS; ++k) {
+                v[k] = uint32_t(1) << (BITS - 1 - k);
+            }
+            continue;
+        }
+
+        const Primitive &primitive = PRIMITIVES[d - 1];
+        int s = primitive.s;
+        for (int k = 0; k < s; ++k) {
+            v[k] = primitive.m[k] << (BITS - 1 - k);
+        }
+        for (int k = s; k < BITS; ++k) {
+            v[k] = v[k - s] ^ (v[k - s] >> s);
+            for (int i = 1; i < s; ++i) {
+                if ((primitive.a >> (s - 1 - i)) & 1) {
+                    v[k] ^= v[k - i];
+                }
+            }
+        }
+    }
+}
+
+void SobolSequence::at(uint32_t i, uint32_t *point) const {
+    uint32_t gray = i ^ (i >> 1);
+    for (int d = 0; d < n_dimensions; ++d) {
+        uint32_t x = 0;
+        for (int k = 0; k < BITS; ++k) {
+            if ((gray >> k) & 1) {
+                x ^= directions[d * BITS + k];
+            }
+        }
+        point[d] = x;
+    }
+}
+
+void SobolSequence::next(uint32_t i, uint32_t *point) const {
+    // Gray codes of i and i + 1 differ in the lowest zero bit of i.
+    int k = __builtin_ctz(~i);
+    for (int d = 0; d < n_dimensions; ++d) {
+        point[d] ^= directions[d * BITS + k];
+    }
+}
+
+}  // namespace FilterModel
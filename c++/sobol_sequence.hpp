@@ -0,0 +1,50 @@
+#ifndef SOBOL_SEQUENCE_HPP
+#define SOBOL_SEQUENCE_HPP
+
+/**
+ * Contains a Sobol low discrepancy sequence for quasi Monte Carlo integration.
+ */
+
+#include <cstdint>
+#include <vector>
+
+namespace FilterModel {
+
+/**
+ * The Sobol sequence in up to MAX_DIMENSIONS dimensions, with Joe and Kuo's direction numbers.
+ *
+ * Points are kept as 32 bit integers, coordinate x / 2^32. The first 2^m points (and each aligned
+ * block of 2^m points after them) stratify every coordinate into 2^m equal intervals, so sample
+ * sizes should be powers of two.
+ *
+ * Points are generated in Gray code order: point i is the sobol point with index i ^ (i >> 1).
+ * This visits the same aligned blocks of points and lets next() update a point with one XOR per
+ * coordinate.
+ */
+class SobolSequence {
+   public:
+    static const int MAX_DIMENSIONS = 10;
+    static const int BITS = 32;
+
+    explicit SobolSequence(int dimensions);
+
+    int dimensions() const { return n_dimensions; }
+
+    /**
+     * Writes the i-th point (in Gray code order) to point, which must have dimensions() entries.
+     */
+    void at(uint32_t i, uint32_t *point) const;
+
+    /**
+     * Turns the i-th point into the (i + 1)-th.
+     */
+    void next(uint32_t i, uint32_t *point) const;
+
+   private:
+    int n_dimensions;
+    // directions[d * BITS + k] is the k-th direction number of dimension d.
+    std::vector<uint32_t> directions;
+};
+}  // namespace FilterModel
+
+#endif
@@ -0,0 +1,68 @@
+#include "../alpha.hpp"
+
+#include <map>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace FilterModel {
+
+TEST(Alpha, BraceInitialisation) {
+    Alpha alpha = {1, 0, 1};
+    ASSERT_EQ(alpha.size(), 3);
+    ASSERT_TRUE(alpha.at(0));
+    ASSERT_FALSE(alpha.at(1));
+    ASSERT_TRUE(alpha.at(2));
+    ASSERT_EQ(alpha.mask(), 5u);
+}
+
+TEST(Alpha, MatchesVector) {
+    std::vector<bool> categories = {false, true, true, false, true};
+    Alpha alpha(categories);
+    ASSERT_EQ(alpha.size(), 5);
+    ASSERT_EQ(alpha.to_vector(), categories);
+    ASSERT_EQ(alpha.count(), 3);
+}
+
+TEST(Alpha, Empty) {
+    Alpha alpha;
+    ASSERT_TRUE(alpha.empty());
+    ASSERT_TRUE(alpha.none());
+    ASSERT_EQ(alpha.count(), 0);
+}
+
+TEST(Alpha, Set) {
+    Alpha alpha = {0, 0, 0};
+    alpha.set(1);
+    ASSERT_EQ(alpha, Alpha({0, 1, 0}));
+    alpha.set(1, false);
+    ASSERT_TRUE(alpha.none());
+}
+
+TEST(Alpha, ComplementKeepsSize) {
+    Alpha alpha = {1, 0, 1};
+    ASSERT_EQ(~alpha, Alpha({0, 1, 0}));
+    ASSERT_EQ((~alpha).size(), 3);
+    ASSERT_EQ(~Alpha({1, 1}), Alpha({0, 0}));
+}
+
+TEST(Alpha, And) { ASSERT_EQ(Alpha({1, 1, 0}) & Alpha({0, 1, 1}), Alpha({0, 1, 0})); }
+
+TEST(Alpha, FromBitsDropsHighBits) {
+    ASSERT_EQ(Alpha::from_bits(0xff, 3), Alpha({1, 1, 1}));
+    ASSERT_EQ(Alpha::from_bits(2, 2), Alpha({0, 1}));
+}
+
+TEST(Alpha, SizeIsPartOfIdentity) {
+    ASSERT_NE(Alpha({1, 0}), Alpha({1, 0, 0}));
+    std::map<Alpha, int> indices;
+    indices[Alpha({1, 0})] = 0;
+    indices[Alpha({1, 0, 0})] = 1;
+    ASSERT_EQ(indices.size(), 2);
+}
+
+TEST(Alpha, ToString) {
+    ASSERT_EQ(vector_to_string(Alpha({1, 0, 1})), "[1,0,1]");
+    ASSERT_EQ(vector_to_string(Alpha()), "[]");
+}
+}  // namespace FilterModel
@@ -0,0 +1,76 @@
+#include "../approximation_dispatcher.hpp"
+#include "../model_distribution.hpp"
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace FilterModel {
+
+TEST(ApproximationDispatcher, LatticePoints) {
+    ASSERT_EQ(ApproximationDispatcher::lattice_points(4, {1, 1, 1}, {3, 5, 7}), 4 * 5);
+    ASSERT_EQ(ApproximationDispatcher::lattice_points(4, {1, 0, 1}, {3, 5, 7}), 4);
+    ASSERT_EQ(ApproximationDispatcher::lattice_points(4, {0, 1, 0}, {3, 5, 7}), 1);
+}
+
+TEST(ApproximationDispatcher, CheaperOnlyForLargeCounts) {
+    ApproximationDispatcher dispatcher(0.01);
+    ASSERT_FALSE(dispatcher.approximation_is_cheaper(10, {1, 1, 1}, {5, 5, 10}));
+    ASSERT_TRUE(dispatcher.approximation_is_cheaper(2000, {1, 1, 1}, {1000, 1000, 2000}));
+    ASSERT_FALSE(dispatcher.approximation_is_cheaper(2000, {1, 0, 0}, {1000, 1000, 2000}));
+}
+
+TEST(ApproximationDispatcher, ZeroToleranceIsExact) {
+    ApproximationDispatcher dispatcher(0.0);
+    ASSERT_FALSE(dispatcher.approximation_is_cheaper(2000, {1, 1, 1}, {1000, 1000, 2000}));
+}
+
+TEST(ApproximationDispatcher, ErrorBound) {
+    DispatchModel model;
+    model.error_constant = 0.5;
+    ApproximationDispatcher dispatcher(0.01, model);
+
+    ASSERT_EQ(dispatcher.log_error_bound({1.0, 0.0, 0, 10.0}), 0);
+    ASSERT_EQ(dispatcher.log_error_bound({0.0, 0.0, 2, 10.0}),
+              std::numeric_limits<double>::infinity());
+    ASSERT_DOUBLE_EQ(dispatcher.log_error_bound({0.5, -3.0, 2, 100.0}), 0.5 / 10.0 / 0.5);
+    ASSERT_FALSE(dispatcher.within_tolerance({0.5, -3.0, 2, 100.0}));
+    ASSERT_TRUE(dispatcher.within_tolerance({0.9, -3.0, 2, 1e5}));
+}
+
+TEST(ApproximationDispatcher, BoundCoversActualError) {
+    ApproximationDispatcher dispatcher(0.01);
+    int n_checked = 0;
+    std::vector<delta_t> deltas = {{0.2, 0.3, 0.5}, {0.1, 0.1, 0.8}, {0.45, 0.1, 0.45}};
+    for (const delta_t &delta : deltas) {
+        for (const category_counts_t &object_counts :
+             std::vector<category_counts_t>({{100, 150, 250}, {40, 300, 160}, {250, 10, 240}})) {
+            for (int n_negative : {100, 250, 400}) {
+                int n_positive = 500 - n_negative;
+                NormalApproximation approximation =
+                    ModelDistribution::calculate_normal_approximation(n_negative, {1, 1, 1}, delta,
+                                                                      object_counts);
+                double bound = dispatcher.log_error_bound(approximation);
+                if (bound > 1) {
+                    continue;
+                }
+                double exact = ModelDistribution::calculate_log_sum_over_k_negative_incremental(
+                    n_positive, n_negative, {1, 1, 1}, delta, object_counts);
+                ASSERT_LE(std::abs(std::log(approximation.sum()) - exact), bound);
+                ++n_checked;
+            }
+        }
+    }
+    ASSERT_GT(n_checked, 5);
+}
+
+TEST(ApproximationDispatcher, CalibrationIsPositive) {
+    DispatchModel model = ApproximationDispatcher::calibrate();
+    ASSERT_GT(model.exact_ns_per_point, 0);
+    ASSERT_GT(model.closed_form_ns, 0);
+    ASSERT_GT(model.mvi3_ns, 0);
+    ASSERT_GT(model.error_constant, 0);
+}
+}  // namespace FilterModel
@@ -0,0 +1,84 @@
+#include <cmath>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../comparison_report.hpp"
+#include "gtest/gtest.h"
+
+namespace FilterModel {
+
+namespace {
+
+ComparisonSample make_sample(int n_negative, double log_error) {
+    return {n_negative, {true, true, true}, 2, -1.0, -1.0 + log_error, 0.01, 100.0, 10.0};
+}
+
+std::vector<std::string> lines(const ComparisonReport &report) {
+    std::stringstream out;
+    report.write_csv(out);
+    std::vector<std::string> result;
+    std::string line;
+    while (std::getline(out, line)) {
+        result.push_back(line);
+    }
+    return result;
+}
+
+}  // namespace
+
+TEST(ComparisonReport, SamplesFraction) {
+    ComparisonReport report(0.25);
+    int sampled = 0;
+    for (int i = 0; i < 100; ++i) {
+        sampled += report.should_sample();
+    }
+    ASSERT_EQ(sampled, 25);
+
+    ComparisonReport everything;
+    for (int i = 0; i < 10; ++i) {
+        ASSERT_TRUE(everything.should_sample());
+    }
+}
+
+TEST(ComparisonReport, BucketsByNNegative) {
+    ComparisonReport report;
+    report.add(make_sample(3, 1e-3));
+    report.add(make_sample(6, 1e-5));
+    report.add(make_sample(7, 0.5));
+
+    std::vector<std::string> rows = lines(report);
+    ASSERT_EQ(rows.size(), 3);
+    ASSERT_EQ(rows.at(1).substr(0, 14), "3,6,2,111,2,0.");
+    ASSERT_EQ(rows.at(2).substr(0, 15), "7,14,2,111,1,0.");
+    ASSERT_EQ(report.size(), 3);
+}
+
+TEST(ComparisonReport, ErrorHistogram) {
+    ComparisonReport report;
+    report.add(make_sample(10, 0.0));
+    report.add(make_sample(10, 5e-3));
+    report.add(make_sample(10, 2.0));
+    report.add(make_sample(10, NAN));
+
+    std::vector<std::string> rows = lines(report);
+    ASSERT_EQ(rows.size(), 2);
+    // Two errors are larger than the bound, then the mean times, then one bin below 1e-8, one
+    // per decade up to 1, and one for the rest.
+    std::string end = ",2,100,10,1,0,0,0,0,0,1,0,0,2";
+    ASSERT_EQ(rows.at(1).substr(rows.at(1).size() - end.size()), end);
+}
+
+TEST(ComparisonReport, MergeAddsBuckets) {
+    ComparisonReport report;
+    report.add(make_sample(10, 1e-3));
+    ComparisonReport other;
+    other.add(make_sample(10, 1e-3));
+    other.add(make_sample(100, 1e-3));
+
+    report.merge(other);
+
+    ASSERT_EQ(report.size(), 3);
+    ASSERT_EQ(lines(report).size(), 3);
+}
+
+}  // namespace FilterModel
@@ -0,0 +1,73 @@
+#include <cmath>
+#include <random>
+#include <vector>
+#include "../convergence_diagnostics.hpp"
+#include "gtest/gtest.h"
+
+namespace FilterModel {
+
+namespace {
+
+/**
+ * Draws chains of an AR(1) process x_t = rho x_{t-1} + e_t, shifting chain j by offset * j.
+ */
+std::vector<std::vector<double>> ar1_chains(int n_chains, int length, double rho, double offset,
+                                            unsigned seed) {
+    std::default_random_engine generator(seed);
+    std::normal_distribution<double> noise;
+    std::vector<std::vector<double>> chains;
+    for (int j = 0; j < n_chains; ++j) {
+        std::vector<double> chain;
+        double x = noise(generator) / std::sqrt(1 - rho * rho);
+        for (int i = 0; i < length; ++i) {
+            x = rho * x + noise(generator);
+            chain.push_back(x + offset * j);
+        }
+        chains.push_back(chain);
+    }
+    return chains;
+}
+
+}  // namespace
+
+TEST(split_r_hat, IndependentDrawsAreMixed) {
+    std::vector<std::vector<double>> chains = ar1_chains(4, 1000, 0.0, 0.0, 1);
+    ASSERT_NEAR(split_r_hat(chains), 1.0, 0.01);
+}
+
+TEST(split_r_hat, SeparatedChainsAreNotMixed) {
+    std::vector<std::vector<double>> chains = ar1_chains(4, 1000, 0.0, 2.0, 2);
+    ASSERT_GT(split_r_hat(chains), 1.5);
+}
+
+TEST(split_r_hat, DriftingChainIsNotMixed) {
+    std::vector<std::vector<double>> chains = ar1_chains(2, 1000, 0.0, 0.0, 3);
+    for (std::vector<double> &chain : chains) {
+        for (int i = 0; i < chain.size(); ++i) {
+            chain[i] += 4.0 * i / chain.size();
+        }
+    }
+    ASSERT_GT(split_r_hat(chains), 1.2);
+}
+
+TEST(split_r_hat, ConstantChains) {
+    ASSERT_EQ(split_r_hat({{1, 1, 1, 1}, {1, 1, 1, 1}}), 1.0);
+    ASSERT_TRUE(std::isinf(split_r_hat({{1, 1, 1, 1}, {0, 0, 0, 0}})));
+}
+
+TEST(effective_sample_size, IndependentDraws) {
+    std::vector<std::vector<double>> chains = ar1_chains(4, 1000, 0.0, 0.0, 4);
+    ASSERT_NEAR(effective_sample_size(chains), 4000, 400);
+}
+
+TEST(effective_sample_size, AutocorrelatedDraws) {
+    // The integrated autocorrelation time of AR(1) is (1 + rho) / (1 - rho) = 9.
+    std::vector<std::vector<double>> chains = ar1_chains(4, 5000, 0.8, 0.0, 5);
+    ASSERT_NEAR(effective_sample_size(chains), 20000.0 / 9, 300);
+}
+
+TEST(effective_sample_size, ConstantChains) {
+    ASSERT_EQ(effective_sample_size({{1, 1, 1, 1}, {1, 1, 1, 1}}), 8);
+}
+
+}  // namespace FilterModel
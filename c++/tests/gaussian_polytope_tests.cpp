@@ -0,0 +1,74 @@
+#include "../gaussian_polytope.hpp"
+#include "../mvi3/mvi3.hpp"
+
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace FilterModel {
+
+TEST(owens_t, KnownValues) {
+    for (double a : {0.1, 0.5, 1.0, 3.0, 40.0}) {
+        ASSERT_NEAR(owens_t(0, a), std::atan(a) / (2 * M_PI), 1e-14);
+    }
+    for (double h : {0.0, 0.3, 1.0, 2.5, 6.0}) {
+        ASSERT_NEAR(owens_t(h, 1), normal_cdf(h) * (1 - normal_cdf(h)) / 2, 1e-14);
+        ASSERT_NEAR(owens_t(h, INFINITY), (1 - normal_cdf(h)) / 2, 1e-14);
+    }
+}
+
+TEST(owens_t, Symmetries) {
+    ASSERT_DOUBLE_EQ(owens_t(1.5, -0.7), -owens_t(1.5, 0.7));
+    ASSERT_DOUBLE_EQ(owens_t(-1.5, 0.7), owens_t(1.5, 0.7));
+}
+
+TEST(gaussian_polytope_probability, Interval) {
+    // x ~ N(0, 4), -1 <= x <= 3
+    double p = gaussian_polytope_probability({{4}}, {{-1, 1}, {1, 3}});
+    ASSERT_NEAR(p, normal_cdf(1.5) - normal_cdf(-0.5), 1e-15);
+
+    // Upper tail 7 <= x / 2 <= 8 without cancellation.
+    p = gaussian_polytope_probability({{4}}, {{-1, -14}, {1, 16}});
+    ASSERT_NEAR(p / (normal_cdf(-7) - normal_cdf(-8)), 1, 1e-12);
+}
+
+TEST(gaussian_polytope_probability, Empty) {
+    ASSERT_EQ(gaussian_polytope_probability({{1}}, {{1, -1}, {-1, -1}}), 0);
+    ASSERT_EQ(gaussian_polytope_probability({{1}, {0.2, 1}}, {{1, 0, -1}, {-1, 0, -1}}), 0);
+}
+
+TEST(gaussian_polytope_probability, Orthant) {
+    for (double rho : {-0.9, -0.5, 0.0, 0.4, 0.95}) {
+        double p = gaussian_polytope_probability({{1}, {rho, 1}}, {{1, 0, 0}, {0, 1, 0}});
+        ASSERT_NEAR(p, 0.25 + std::asin(rho) / (2 * M_PI), 1e-14);
+    }
+}
+
+TEST(gaussian_polytope_probability, IndependentRectangle) {
+    double p = gaussian_polytope_probability(
+        {{4}, {0, 9}}, {{1, 0, 1}, {-1, 0, 3}, {0, 1, 2}, {0, -1, 0.5}});
+    ASSERT_NEAR(p,
+                (normal_cdf(0.5) - normal_cdf(-1.5)) *
+                    (normal_cdf(2.0 / 3.0) - normal_cdf(-0.5 / 3.0)),
+                1e-14);
+}
+
+TEST(gaussian_polytope_probability, TriangleAwayFromOrigin) {
+    // x >= 3, y >= 0, x + y <= 5, from one dimensional quadrature of phi(x) (Phi(5 - x) - 1 / 2).
+    double p = gaussian_polytope_probability({{1}, {0, 1}}, {{-1, 0, -3}, {0, -1, 0}, {1, 1, 5}});
+    ASSERT_NEAR(p, 6.084665268585056e-4, 1e-15);
+}
+
+TEST(gaussian_polytope_probability, AgreesWithMvi3) {
+    // The shifted constraints of a multinomial approximation, 0 <= k_1, k_2 and n - k_1 - k_2.
+    std::vector<std::vector<double>> covariance = {{6.4, -1.6}, {-1.6, 4.2}};
+    std::vector<std::vector<double>> hyperplanes = {
+        {1, 1, 3.5}, {-1, -1, 1.0}, {-1, 0, 4.0}, {1, 0, 2.0}, {0, -1, 3.0}, {0, 1, 1.5}};
+
+    double exact = gaussian_polytope_probability(covariance, hyperplanes);
+    MVI3::Estimate estimate =
+        MVI3::Mvi3().estimate(457, -1, 2000, 10, covariance, hyperplanes);
+    ASSERT_NEAR(exact, estimate.value, 4 * estimate.standard_error);
+}
+}  // namespace FilterModel
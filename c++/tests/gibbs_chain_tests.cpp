@@ -0,0 +1,142 @@
+#include <cmath>
+#include <numeric>
+#include <vector>
+#include "../gibbs_chain.hpp"
+#include "../types.hpp"
+#include "../utils.hpp"
+#include "gtest/gtest.h"
+
+namespace FilterModel {
+
+TEST(GibbsChain, SameSeedSameTrace) {
+    std::vector<category_counts_t> data = {{5, 0, 1}, {2, 2, 2}, {0, 7, 1}};
+    Options options;
+    options.record_likelyhood = true;
+    GibbsChain first(data, options, 17);
+    GibbsChain second(data, options, 17);
+    for (int i = 0; i < 3; ++i) {
+        first.step();
+        second.step();
+    }
+
+    ASSERT_EQ(first.size(), 4);
+    ASSERT_EQ(first.get_models(), second.get_models());
+    ASSERT_EQ(first.get_epsilons(), second.get_epsilons());
+    ASSERT_EQ(first.get_deltas(), second.get_deltas());
+    ASSERT_EQ(first.get_log_likelyhoods().size(), 4);
+    ASSERT_TRUE(std::isnan(first.get_log_likelyhoods().front()));
+    ASSERT_EQ(first.get_log_likelyhoods().back(), second.get_log_likelyhoods().back());
+}
+
+TEST(GibbsChain, FixedAlphas) {
+    std::vector<category_counts_t> data = {{5, 0, 1}, {2, 2, 2}};
+    Options options;
+    options.fixed_alphas = {{true, false, true}, {true, true, true}};
+    GibbsChain chain(data, options, 3);
+    chain.step();
+    chain.step();
+
+    ASSERT_TRUE(chain.get_models().front().empty());
+    ASSERT_EQ(chain.get_models().at(1), options.fixed_alphas);
+    ASSERT_EQ(chain.get_models().at(2), options.fixed_alphas);
+    for (double epsilon : chain.get_epsilons()) {
+        ASSERT_GE(epsilon, 0);
+        ASSERT_LE(epsilon, 1);
+    }
+}
+
+TEST(GibbsChain, MultipleTriesRepeatable) {
+    std::vector<category_counts_t> data = {{5, 0, 1}, {2, 2, 2}, {0, 7, 1}};
+    Options options;
+    options.tries = 3;
+    GibbsChain first(data, options, 23);
+    GibbsChain second(data, options, 23);
+    first.step();
+    second.step();
+
+    ASSERT_EQ(first.get_epsilons(), second.get_epsilons());
+    ASSERT_EQ(first.get_deltas(), second.get_deltas());
+}
+
+TEST(GibbsChain, AdaptsOnlyDuringAdaptIterations) {
+    std::vector<category_counts_t> data = {{5, 0, 1}, {2, 2, 2}, {0, 7, 1}};
+    Options options;
+    options.adapt_iterations = 2;
+    GibbsChain chain(data, options, 29);
+    for (int i = 0; i < 4; ++i) {
+        chain.step();
+    }
+
+    ASSERT_EQ(chain.get_epsilon_acceptance().size(), 5);
+    ASSERT_EQ(chain.get_delta_acceptance().size(), 5);
+    ASSERT_TRUE(std::isnan(chain.get_epsilon_acceptance().front()));
+    for (int i = 1; i < 5; ++i) {
+        ASSERT_GE(chain.get_epsilon_acceptance()[i], 0);
+        ASSERT_LE(chain.get_epsilon_acceptance()[i], 1);
+    }
+    ASSERT_EQ(chain.get_epsilon_scales().size(), 5);
+    ASSERT_EQ(chain.get_delta_scales().front(), 0.25);
+    ASSERT_EQ(chain.get_epsilon_scales().back(), chain.get_epsilon_scale().get());
+    // Fixed after the adapting steps.
+    ASSERT_EQ(chain.get_delta_scales().at(3), chain.get_delta_scales().at(4));
+    ASSERT_FALSE(chain.get_epsilon_scale().is_adapting());
+    ASSERT_NE(chain.get_epsilon_scale().get(), 0.25);
+    ASSERT_EQ(chain.get_delta_scale().get_proposals(), 40);
+}
+
+TEST(GibbsChain, FixedScaleWithoutAdaptation) {
+    std::vector<category_counts_t> data = {{5, 0, 1}, {2, 2, 2}};
+    Options options;
+    GibbsChain chain(data, options, 31);
+    chain.step();
+
+    ASSERT_EQ(chain.get_epsilon_scale().get(), 0.25);
+    ASSERT_EQ(chain.get_delta_scale().get(), 0.25);
+}
+
+TEST(GibbsChain, CarriedLikelyhoodMatchesDistribution) {
+    std::vector<category_counts_t> data = {{5, 0, 1}, {2, 2, 2}, {0, 7, 1}};
+    for (bool fixed : {false, true}) {
+        Options options;
+        options.record_likelyhood = true;
+        if (fixed) {
+            options.fixed_alphas = {{true, false, true}, {true, true, true}, {false, true, true}};
+        }
+        GibbsChain chain(data, options, 37);
+        for (int i = 0; i < 3; ++i) {
+            chain.step();
+            std::vector<std::vector<alpha_t>> alphas_per_object;
+            for (const alpha_t &alpha : chain.get_models().back()) {
+                alphas_per_object.push_back({alpha});
+            }
+            std::vector<double> per_object =
+                flatten<double>(chain.get_model_distribution().distribution(
+                    alphas_per_object, chain.get_epsilons().back(), chain.get_deltas().back()));
+            ASSERT_NEAR(chain.get_log_likelyhoods().back(),
+                        std::accumulate(per_object.begin(), per_object.end(), 0.0), 1e-9);
+        }
+    }
+}
+
+TEST(GibbsChain, SameTraceOnAnyNumberOfThreads) {
+    std::vector<category_counts_t> data = {{5, 0, 1}, {2, 2, 2}, {0, 7, 1}, {3, 3, 0}, {1, 0, 6}};
+    Options serial_options;
+    serial_options.record_likelyhood = true;
+    Options parallel_options = serial_options;
+    parallel_options.threads = 3;
+    parallel_options.tries = 2;
+    serial_options.tries = 2;
+    GibbsChain serial(data, serial_options, 47);
+    GibbsChain parallel(data, parallel_options, 47);
+    for (int i = 0; i < 3; ++i) {
+        serial.step();
+        parallel.step();
+    }
+
+    ASSERT_EQ(serial.get_models(), parallel.get_models());
+    ASSERT_EQ(serial.get_epsilons(), parallel.get_epsilons());
+    ASSERT_EQ(serial.get_deltas(), parallel.get_deltas());
+    ASSERT_EQ(serial.get_log_likelyhoods().back(), parallel.get_log_likelyhoods().back());
+}
+
+}  // namespace FilterModel
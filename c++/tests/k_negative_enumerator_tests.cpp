@@ -0,0 +1,109 @@
+#include "../k_negative_enumerator.hpp"
+
+#include <numeric>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace FilterModel {
+
+/**
+ * Every k^- in the box [0, k] that satisfies the constraints, in lexicographic order.
+ */
+std::vector<std::vector<int>> brute_force_k_negatives(int n_positive, int n_negative,
+                                                      const alpha_t &alpha,
+                                                      const category_counts_t &object_counts) {
+    std::vector<std::vector<int>> k_negatives;
+    std::vector<int> k_negative(object_counts.size(), 0);
+    while (true) {
+        bool valid = std::accumulate(k_negative.begin(), k_negative.end(), 0) == n_negative;
+        for (int i = 0; i < k_negative.size(); ++i) {
+            valid = valid && object_counts[i] - k_negative[i] <= n_positive &&
+                    (alpha[i] || k_negative[i] == object_counts[i]);
+        }
+        if (valid) {
+            k_negatives.push_back(k_negative);
+        }
+
+        int i = k_negative.size() - 1;
+        while (i >= 0 && k_negative[i] == object_counts[i]) {
+            k_negative[i] = 0;
+            --i;
+        }
+        if (i < 0) {
+            return k_negatives;
+        }
+        ++k_negative[i];
+    }
+}
+
+template <int N>
+std::vector<std::vector<int>> enumerated_k_negatives(int n_positive, int n_negative,
+                                                     const alpha_t &alpha,
+                                                     const category_counts_t &object_counts) {
+    std::vector<std::vector<int>> k_negatives;
+    KNegativeEnumerator<N>::points(
+        [&k_negatives](const int *k_negative) {
+            k_negatives.push_back(std::vector<int>(k_negative, k_negative + N));
+        },
+        n_positive, n_negative, alpha, object_counts);
+    return k_negatives;
+}
+
+TEST(KNegativeEnumerator, OneCategory) {
+    ASSERT_EQ(enumerated_k_negatives<1>(0, 4, {1}, {4}), std::vector<std::vector<int>>({{4}}));
+    ASSERT_TRUE(enumerated_k_negatives<1>(1, 3, {0}, {4}).empty());
+}
+
+TEST(KNegativeEnumerator, TwoCategories) {
+    category_counts_t object_counts = {3, 2};
+    for (int n_negative = 0; n_negative <= 5; ++n_negative) {
+        for (const alpha_t &alpha : std::vector<alpha_t>({{1, 1}, {1, 0}, {0, 1}})) {
+            ASSERT_EQ(enumerated_k_negatives<2>(5 - n_negative, n_negative, alpha, object_counts),
+                      brute_force_k_negatives(5 - n_negative, n_negative, alpha, object_counts));
+        }
+    }
+}
+
+TEST(KNegativeEnumerator, FourCategoriesMatchBruteForce) {
+    category_counts_t object_counts = {2, 0, 3, 4};
+    for (int n_negative = 0; n_negative <= 9; ++n_negative) {
+        for (const alpha_t &alpha :
+             std::vector<alpha_t>({{1, 1, 1, 1}, {1, 0, 1, 1}, {0, 1, 1, 0}, {1, 1, 0, 1}})) {
+            ASSERT_EQ(enumerated_k_negatives<4>(9 - n_negative, n_negative, alpha, object_counts),
+                      brute_force_k_negatives(9 - n_negative, n_negative, alpha, object_counts));
+        }
+    }
+}
+
+TEST(KNegativeEnumerator, SixCategoriesMatchBruteForce) {
+    category_counts_t object_counts = {1, 2, 0, 2, 1, 3};
+    alpha_t alpha = {1, 1, 0, 1, 0, 1};
+    for (int n_negative = 0; n_negative <= 9; ++n_negative) {
+        ASSERT_EQ(enumerated_k_negatives<6>(9 - n_negative, n_negative, alpha, object_counts),
+                  brute_force_k_negatives(9 - n_negative, n_negative, alpha, object_counts));
+    }
+}
+
+TEST(KNegativeEnumerator, RowsAreNonEmpty) {
+    int n_points = 0;
+    KNegativeEnumerator<4>::rows(
+        [&n_points](const int *k_negative, int start, int end) {
+            ASSERT_LE(start, end);
+            n_points += end - start + 1;
+        },
+        3, 6, {1, 1, 1, 1}, {2, 2, 2, 3});
+    ASSERT_EQ(n_points, brute_force_k_negatives(3, 6, {1, 1, 1, 1}, {2, 2, 2, 3}).size());
+}
+
+template <int N>
+struct CategoryCount {
+    static int run(int offset) { return N + offset; }
+};
+
+TEST(dispatch_categories, PicksSpecialisation) {
+    for (int n_categories = 1; n_categories <= MAX_CATEGORIES; ++n_categories) {
+        ASSERT_EQ(dispatch_categories<CategoryCount>(n_categories, 10), n_categories + 10);
+    }
+}
+}  // namespace FilterModel
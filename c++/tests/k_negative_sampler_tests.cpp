@@ -0,0 +1,81 @@
+#include <random>
+#include <vector>
+#include "../k_negative_sampler.hpp"
+#include "../monte_carlo_integration.hpp"
+#include "gtest/gtest.h"
+
+namespace FilterModel {
+
+TEST(KNegativeSliceSampler, PointsAreInSlice) {
+    std::vector<double> capacities = {3, 1, 4, 2};
+    double n_negative = 6;
+    KNegativeSliceSampler sampler(n_negative, capacities);
+    ASSERT_EQ(sampler.dimensions(), 3);
+
+    std::default_random_engine generator;
+    std::uniform_real_distribution<double> uniform;
+    int n_points = 1000;
+    std::vector<double> u(n_points * 3);
+    for (double &u_i : u) {
+        u_i = uniform(generator);
+    }
+    std::vector<double> points(n_points * 3);
+    std::vector<double> weights(n_points);
+    sampler(u, n_points, points, weights);
+
+    for (int j = 0; j < n_points; ++j) {
+        double last = n_negative;
+        for (int i = 0; i < 3; ++i) {
+            ASSERT_GE(points[j * 3 + i], 0);
+            ASSERT_LE(points[j * 3 + i], capacities[i]);
+            last -= points[j * 3 + i];
+        }
+        ASSERT_GE(last, -1e-12);
+        ASSERT_LE(last, capacities[3] + 1e-12);
+        ASSERT_GT(weights[j], 0);
+    }
+}
+
+TEST(KNegativeSliceSampler, IntegratesOverSlice) {
+    // 0 <= x, y <= 2 and 1 <= x + y <= 3 is the square less two corners, with area 3, and is
+    // symmetric about (1, 1).
+    KNegativeSliceSampler sampler(3, {2, 2, 2});
+    auto area_sum = [](const std::vector<double> &points, const std::vector<double> &weights,
+                       int n_points) {
+        double sum = 0.0;
+        for (int j = 0; j < n_points; ++j) {
+            sum += weights[j];
+        }
+        return sum;
+    };
+    auto x_sum = [](const std::vector<double> &points, const std::vector<double> &weights,
+                    int n_points) {
+        double sum = 0.0;
+        for (int j = 0; j < n_points; ++j) {
+            sum += weights[j] * points[j * 2];
+        }
+        return sum;
+    };
+
+    IntegrationOptions options;
+    options.relative_tolerance = 1e-5;
+    std::default_random_engine generator;
+    IntegrationEstimate area = integrate_qmc_blocks(area_sum, sampler, 2, generator, options);
+    IntegrationEstimate x = integrate_qmc_blocks(x_sum, sampler, 2, generator, options);
+
+    ASSERT_NEAR(area.value, 3.0, 5 * area.standard_error + 1e-12);
+    ASSERT_NEAR(x.value, 3.0, 5 * x.standard_error + 1e-12);
+}
+
+TEST(KNegativeSliceSampler, EmptySliceHasNoWeight) {
+    KNegativeSliceSampler sampler(7, {2, 2, 2});
+    std::vector<double> u = {0.5, 0.5, 0.1, 0.9};
+    std::vector<double> points(4);
+    std::vector<double> weights(2);
+    sampler(u, 2, points, weights);
+
+    ASSERT_EQ(weights[0], 0);
+    ASSERT_EQ(weights[1], 0);
+}
+
+}  // namespace FilterModel
@@ -0,0 +1,32 @@
+#include "../log_factorial.hpp"
+
+#include <cmath>
+
+#include "gtest/gtest.h"
+
+namespace FilterModel {
+
+TEST(log_factorial, SmallValuesCorrect) {
+    ASSERT_EQ(LogFactorial::log_factorial(0), 0.0);
+    ASSERT_EQ(LogFactorial::log_factorial(1), 0.0);
+    ASSERT_NEAR(LogFactorial::log_factorial(5), std::log(120.0), 1e-12);
+}
+
+TEST(log_factorial, MatchesLgamma) {
+    LogFactorial::reserve(1000);
+    for (int n = 0; n <= 1000; ++n) {
+        ASSERT_EQ(LogFactorial::log_factorial(n), std::lgamma(n + 1.0));
+    }
+}
+
+TEST(log_factorial, GrowsPastTable) {
+    int n = LogFactorial::table_size() + 100000;
+    ASSERT_EQ(LogFactorial::log_factorial(n), std::lgamma(n + 1.0));
+    ASSERT_GT(LogFactorial::table_size(), n);
+}
+
+TEST(log_factorial, NegativeFallsBackToLgamma) {
+    ASSERT_EQ(LogFactorial::log_factorial(-1), INFINITY);
+}
+
+}  // namespace FilterModel
@@ -0,0 +1,70 @@
+#include "../log_sum_exp.hpp"
+
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace FilterModel {
+const double ERROR = 0.0001;
+
+TEST(LogSumExp, Empty) {
+    LogSumExp<> sum;
+    ASSERT_EQ(sum.result(), -INFINITY);
+}
+
+TEST(LogSumExp, NegativeInfinityIgnored) {
+    LogSumExp<> sum;
+    sum.add(-INFINITY);
+    ASSERT_EQ(sum.result(), -INFINITY);
+    sum.add(std::log(0.5));
+    sum.add(-INFINITY);
+    ASSERT_NEAR(sum.result(), std::log(0.5), ERROR);
+}
+
+TEST(LogSumExp, ManyNumbers) {
+    LogSumExp<> sum;
+    for (double x : {0.1, 0.2, 0.3, 0.4}) {
+        sum.add(std::log(x));
+    }
+    ASSERT_NEAR(sum.result(), 0.0, ERROR);
+}
+
+TEST(LogSumExp, DoesntUnderflow) {
+    LogSumExp<> sum;
+    sum.add(-5000.0);
+    sum.add(-5000.0);
+    ASSERT_NEAR(sum.result(), -5000.0 + std::log(2.0), ERROR);
+}
+
+TEST(LogSumExp, CompensatedIsAccurate) {
+    LogSumExp<true> sum;
+    sum.add(0.0);
+    for (int i = 0; i < 1000000; ++i) {
+        sum.add(std::log(1e-16));
+    }
+    ASSERT_NEAR(std::exp(sum.result()), 1.0 + 1e-10, 1e-15);
+}
+
+TEST(LogSumExp, MergeMatchesSerial) {
+    std::vector<double> terms = {-3.0, -700.0, 2.0, -0.5, 10.0, -1000.0};
+    LogSumExp<> serial;
+    LogSumExp<> first_half;
+    LogSumExp<> second_half;
+    for (int i = 0; i < terms.size(); ++i) {
+        serial.add(terms.at(i));
+        if (i < terms.size() / 2) {
+            first_half.add(terms.at(i));
+        } else {
+            second_half.add(terms.at(i));
+        }
+    }
+    first_half.merge(second_half);
+    ASSERT_NEAR(first_half.result(), serial.result(), 1e-12);
+
+    LogSumExp<> empty;
+    empty.merge(serial);
+    ASSERT_EQ(empty.result(), serial.result());
+}
+
+}  // namespace FilterModel
@@ -1,10 +1,10 @@
 #include "../metropolis_hastings.hpp"
+#include "../thread_pool.hpp"
 #include "../utils.hpp"
 #include "gtest/gtest.h"
 
 #include <boost/log/trivial.hpp>
 #include <boost/math/distributions/beta.hpp>
-#include <chrono>
 #include <fstream>
 #include <iostream>
 #include <random>
@@ -14,7 +14,7 @@ namespace FilterModel {
 TEST(sample, wtv) {
     boost::math::beta_distribution<double> dist(2, 2);
     std::default_random_engine generator;
-    generator.seed(std::chrono::system_clock::now().time_since_epoch().count());
+    generator.seed(1);
 
     std::vector<double> values;
 
@@ -50,4 +50,140 @@ TEST(sample, wtv) {
     }
 }
 
+namespace {
+
+double standard_normal_log_pdf(double x) { return -0.5 * x * x; }
+
+double uniform_start(std::default_random_engine &gen) {
+    return std::uniform_real_distribution<double>(-1, 1)(gen);
+}
+
+double random_walk(double center, std::default_random_engine &gen) {
+    return std::normal_distribution<double>(center, 2.0)(gen);
+}
+
+}  // namespace
+
+TEST(sample_multiple_try, OneTryMatchesSample) {
+    std::default_random_engine generator(5);
+    std::vector<double> values;
+    MetropolisHastingsSampler::sample<double, std::default_random_engine>(
+        200, standard_normal_log_pdf, uniform_start, random_walk, generator, &values);
+
+    std::default_random_engine multiple_try_generator(5);
+    std::vector<double> multiple_try_values;
+    MetropolisHastingsSampler::sample_multiple_try<double, std::default_random_engine>(
+        200, 1, standard_normal_log_pdf, uniform_start, random_walk, multiple_try_generator,
+        nullptr, &multiple_try_values);
+
+    ASSERT_EQ(multiple_try_values, values);
+}
+
+TEST(sample_multiple_try, TargetsDistribution) {
+    std::default_random_engine generator(7);
+    ThreadPool thread_pool(4);
+    std::vector<double> values;
+    MetropolisHastingsSampler::sample_multiple_try<double, std::default_random_engine>(
+        50000, 4, standard_normal_log_pdf, uniform_start, random_walk, generator, &thread_pool,
+        &values);
+
+    double mean = 0.0;
+    double second_moment = 0.0;
+    for (double value : values) {
+        mean += value / values.size();
+        second_moment += value * value / values.size();
+    }
+    ASSERT_NEAR(mean, 0.0, 0.05);
+    ASSERT_NEAR(second_moment, 1.0, 0.05);
+}
+
+TEST(sample_multiple_try, SameChainWithThreads) {
+    std::default_random_engine serial_generator(11);
+    std::vector<double> serial_values;
+    MetropolisHastingsSampler::sample_multiple_try<double, std::default_random_engine>(
+        500, 8, standard_normal_log_pdf, uniform_start, random_walk, serial_generator, nullptr,
+        &serial_values);
+
+    std::default_random_engine parallel_generator(11);
+    ThreadPool thread_pool(4);
+    std::vector<double> parallel_values;
+    MetropolisHastingsSampler::sample_multiple_try<double, std::default_random_engine>(
+        500, 8, standard_normal_log_pdf, uniform_start, random_walk, parallel_generator,
+        &thread_pool, &parallel_values);
+
+    ASSERT_EQ(parallel_values, serial_values);
+}
+
+TEST(sample_from, SkipsKnownStartLogPdf) {
+    int calls = 0;
+    std::function<double(double)> counting_log_pdf = [&calls](double x) {
+        ++calls;
+        return standard_normal_log_pdf(x);
+    };
+    std::default_random_engine generator(13);
+    MetropolisHastingsState<double> state =
+        MetropolisHastingsSampler::sample_from<double, std::default_random_engine>(
+            5, {0.5, standard_normal_log_pdf(0.5)}, counting_log_pdf, random_walk, generator);
+    ASSERT_EQ(calls, 5);
+    ASSERT_EQ(state.log_pdf, standard_normal_log_pdf(state.value));
+
+    calls = 0;
+    state = MetropolisHastingsSampler::sample_multiple_try_from<double, std::default_random_engine>(
+        5, 1, {state.value, NAN}, counting_log_pdf, random_walk, generator);
+    ASSERT_EQ(calls, 6);
+    ASSERT_EQ(state.log_pdf, standard_normal_log_pdf(state.value));
+}
+
+TEST(sample_from, SampleStartsFromUniformDraw) {
+    std::default_random_engine first_generator(17);
+    std::default_random_engine second_generator(17);
+    double sampled = MetropolisHastingsSampler::sample<double, std::default_random_engine>(
+        20, standard_normal_log_pdf, uniform_start, random_walk, first_generator);
+    double start = uniform_start(second_generator);
+    MetropolisHastingsState<double> state =
+        MetropolisHastingsSampler::sample_from<double, std::default_random_engine>(
+            20, {start, NAN}, standard_normal_log_pdf, random_walk, second_generator);
+
+    ASSERT_EQ(sampled, state.value);
+}
+
+TEST(ProposalScale, CountsProposals) {
+    std::default_random_engine generator(5);
+    ProposalScale scale(2.0);
+    MetropolisHastingsSampler::sample<double, std::default_random_engine>(
+        100, standard_normal_log_pdf, uniform_start, random_walk, generator, nullptr, &scale);
+
+    ASSERT_EQ(scale.get_proposals(), 100);
+    ASSERT_GT(scale.get_accepted(), 0);
+    ASSERT_LT(scale.get_accepted(), 100);
+    // Not adapting, so the scale stays put.
+    ASSERT_EQ(scale.get(), 2.0);
+}
+
+TEST(ProposalScale, AdaptsToTargetAcceptance) {
+    std::default_random_engine generator(11);
+    // Far too small a step, which accepts almost everything.
+    ProposalScale scale(0.01, 0.44);
+    auto scaled_walk = [&scale](double center, std::default_random_engine &gen) {
+        return std::normal_distribution<double>(center, scale.get())(gen);
+    };
+    scale.set_adapting(true);
+    MetropolisHastingsSampler::sample<double, std::default_random_engine>(
+        5000, standard_normal_log_pdf, uniform_start, scaled_walk, generator, nullptr, &scale);
+    scale.set_adapting(false);
+
+    long proposals = scale.get_proposals();
+    long accepted = scale.get_accepted();
+    double adapted = scale.get();
+    MetropolisHastingsSampler::sample<double, std::default_random_engine>(
+        20000, standard_normal_log_pdf, uniform_start, scaled_walk, generator, nullptr, &scale);
+
+    ASSERT_EQ(scale.get(), adapted);
+    // About 2.4 standard deviations is optimal for a one dimensional normal.
+    ASSERT_GT(adapted, 1.0);
+    ASSERT_LT(adapted, 5.0);
+    ASSERT_NEAR(double(scale.get_accepted() - accepted) / (scale.get_proposals() - proposals), 0.44,
+                0.05);
+}
+
 }  // namespace FilterModel
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "../model_distribution.hpp"
+#include "../multinomial.hpp"
 #include "gtest/gtest.h"
 
 double ERROR = 0.0001;
@@ -151,6 +152,38 @@ TEST(iterate_over_k_negatives, NoResults) {
     ASSERT_EQ(k_negatives, std::vector<std::vector<int>>({}));
 }
 
+TEST(iterate_over_k_negatives, WorksWithStdFunction) {
+    int n_positive = 3;
+    int n_negative = 3;
+    std::vector<int> k = {2, 2, 2};
+    alpha_t alpha = {true, false, true};
+
+    std::vector<std::vector<int>> k_negatives;
+    std::function<void(int, int, int)> f = [&k_negatives](int k_1_negative, int k_2_negative,
+                                                          int k_3_negative) {
+        k_negatives.push_back(std::vector<int>({k_1_negative, k_2_negative, k_3_negative}));
+    };
+    ModelDistribution::iterate_over_k_negatives(f, n_positive, n_negative, alpha, k);
+
+    ASSERT_EQ(k_negatives, std::vector<std::vector<int>>({{0, 2, 1}, {1, 2, 0}}));
+}
+
+TEST(iterate_over_k_negative_rows, WorksWithAlphaTrue) {
+    int n_positive = 3;
+    int n_negative = 3;
+    std::vector<int> k = {2, 2, 2};
+    alpha_t alpha = {true, true, true};
+
+    std::vector<std::vector<int>> rows;
+    ModelDistribution::iterate_over_k_negative_rows(
+        [&rows](int k_1_negative, int k_2_negative_start, int k_2_negative_end) {
+            rows.push_back(std::vector<int>({k_1_negative, k_2_negative_start, k_2_negative_end}));
+        },
+        n_positive, n_negative, alpha, k);
+
+    ASSERT_EQ(rows, std::vector<std::vector<int>>({{0, 1, 2}, {1, 0, 2}, {2, 0, 1}}));
+}
+
 TEST(calculate_sum_over_k_negative_exact, StandardSetup) {
     int n_positive = 3;
     int n_negative = 3;
@@ -177,6 +210,84 @@ TEST(calculate_sum_over_k_negative_exact, NoTerms) {
     ASSERT_NEAR(result, 0.0, ERROR);
 }
 
+TEST(calculate_log_sum_over_k_negative_incremental, StandardSetup) {
+    int n_positive = 3;
+    int n_negative = 3;
+    alpha_t alpha = {true, true, true};
+    delta_t delta = {1.0 / 2.0, 1.0 / 3.0, 1.0 / 6.0};
+    category_counts_t object_counts = {2, 2, 2};
+
+    double result = ModelDistribution::calculate_log_sum_over_k_negative_incremental(
+        n_positive, n_negative, alpha, delta, object_counts);
+
+    ASSERT_NEAR(result, std::log(5.0 / 6.0), ERROR);
+}
+
+TEST(calculate_log_sum_over_k_negative_incremental, NoTerms) {
+    int n_positive = 3;
+    int n_negative = 3;
+    alpha_t alpha = {true, false, false};
+    delta_t delta = {1.0 / 2.0, 1.0 / 3.0, 1.0 / 6.0};
+    category_counts_t object_counts = {2, 2, 2};
+
+    double result = ModelDistribution::calculate_log_sum_over_k_negative_incremental(
+        n_positive, n_negative, alpha, delta, object_counts);
+
+    ASSERT_EQ(result, -INFINITY);
+}
+
+TEST(calculate_log_sum_over_k_negative_incremental, MatchesExact) {
+    delta_t delta = {0.2, 0.7, 0.1};
+    category_counts_t object_counts = {150, 400, 60};
+    int n = 610;
+    for (alpha_t alpha : std::vector<alpha_t>(
+             {{true, true, true}, {true, false, true}, {false, true, true}, {true, true, false}})) {
+        for (int n_positive : {0, 100, 300, 500}) {
+            double exact = ModelDistribution::calculate_sum_over_k_negative_exact(
+                n_positive, n - n_positive, alpha, delta, object_counts);
+            double incremental =
+                std::exp(ModelDistribution::calculate_log_sum_over_k_negative_incremental(
+                    n_positive, n - n_positive, alpha, delta, object_counts));
+            ASSERT_NEAR(incremental, exact, 1e-9 * exact);
+        }
+    }
+}
+
+TEST(calculate_log_sum_over_k_negative_incremental, FourCategories) {
+    delta_t delta = {0.1, 0.2, 0.3, 0.4};
+    category_counts_t object_counts = {3, 4, 2, 5};
+    alpha_t alpha = {true, true, false, true};
+    int n = 14;
+    for (int n_positive = 0; n_positive <= 12; ++n_positive) {
+        int n_negative = n - n_positive;
+        Multinomial m(n_negative, delta);
+        double brute_force = 0.0;
+        KNegativeEnumerator<4>::points(
+            [&brute_force, &m](const int *k_negative) {
+                brute_force += std::exp(m.log_pdf(std::vector<int>(k_negative, k_negative + 4)));
+            },
+            n_positive, n_negative, alpha, object_counts);
+
+        double exact = ModelDistribution::calculate_sum_over_k_negative_exact(
+            n_positive, n_negative, alpha, delta, object_counts);
+        double incremental =
+            std::exp(ModelDistribution::calculate_log_sum_over_k_negative_incremental(
+                n_positive, n_negative, alpha, delta, object_counts));
+        ASSERT_NEAR(exact, brute_force, 1e-12);
+        ASSERT_NEAR(incremental, brute_force, 1e-12);
+    }
+}
+
+TEST(calculate_log_sum_over_k_negative_incremental, TwoCategories) {
+    delta_t delta = {0.25, 0.75};
+    category_counts_t object_counts = {2, 3};
+    // k^- is one of {0, 3}, {1, 2}, {2, 1}.
+    double expected = 0.75 * 0.75 * 0.75 + 3 * 0.25 * 0.75 * 0.75 + 3 * 0.25 * 0.25 * 0.75;
+    double result = std::exp(ModelDistribution::calculate_log_sum_over_k_negative_incremental(
+        2, 3, {true, true}, delta, object_counts));
+    ASSERT_NEAR(result, expected, ERROR);
+}
+
 TEST(calculate_log_sum_over_k_negative, StandardSetup) {
     int n_positive = 3;
     int n_negative = 3;
@@ -184,10 +295,9 @@ TEST(calculate_log_sum_over_k_negative, StandardSetup) {
     delta_t delta = {1.0 / 2.0, 1.0 / 3.0, 1.0 / 6.0};
     category_counts_t object_counts = {2, 2, 2};
 
-    std::default_random_engine gen;
     Options options;
     options.exact = true;
-    ModelDistribution model_distribution(std::vector<category_counts_t>({}), gen, options);
+    ModelDistribution model_distribution(std::vector<category_counts_t>({}), options);
 
     double result = model_distribution.calculate_log_sum_over_k_negative(
         n_positive, n_negative, alpha, delta, object_counts);
@@ -202,10 +312,9 @@ TEST(calculate_log_sum_over_k_negative, NoTerms) {
     delta_t delta = {1.0 / 2.0, 1.0 / 3.0, 1.0 / 6.0};
     category_counts_t object_counts = {2, 2, 2};
 
-    std::default_random_engine gen;
     Options options;
     options.exact = true;
-    ModelDistribution model_distribution(std::vector<category_counts_t>({}), gen, options);
+    ModelDistribution model_distribution(std::vector<category_counts_t>({}), options);
 
     double result = model_distribution.calculate_log_sum_over_k_negative(
         n_positive, n_negative, alpha, delta, object_counts);
@@ -213,6 +322,24 @@ TEST(calculate_log_sum_over_k_negative, NoTerms) {
     ASSERT_EQ(result, -INFINITY);
 }
 
+TEST(calculate_log_sum_over_k_negative_incremental, LargeCountsDontUnderflow) {
+    int n_positive = 0;
+    int n_negative = 6000;
+    alpha_t alpha = {true, true, true};
+    delta_t delta = {0.98, 0.01, 0.01};
+    category_counts_t object_counts = {10, 10, 5980};
+
+    double result = ModelDistribution::calculate_log_sum_over_k_negative_incremental(
+        n_positive, n_negative, alpha, delta, object_counts);
+
+    // Only k^- = k is possible, so the sum is the single multinomial term.
+    std::vector<double> p = delta;
+    double expected = std::lgamma(6001.0) - std::lgamma(11.0) - std::lgamma(11.0) -
+                      std::lgamma(5981.0) + 10 * std::log(p[0]) + 10 * std::log(p[1]) +
+                      5980 * std::log(p[2]);
+    ASSERT_NEAR(result, expected, 1e-6 * std::abs(expected));
+}
+
 TEST(calculate_log_p_k_positive_given_alpha_n_positive, Tests) {
     ASSERT_EQ(ModelDistribution::calculate_log_p_k_positive_given_alpha_n_positive(
                   5, {false, true, false}),
@@ -227,10 +354,9 @@ TEST(calculate_log_p_k_positive_given_alpha_n_positive, Tests) {
 
 TEST(distribution, AllNonzero) {
     std::vector<category_counts_t> data = {{2, 2, 2}};
-    std::default_random_engine generator;
     Options options;
     options.exact = true;
-    ModelDistribution model_distribution(data, generator, options);
+    ModelDistribution model_distribution(data, options);
 
     alpha_t alpha_true = {true, true, true};
     std::vector<alpha_t> alphas = {alpha_true};
@@ -242,10 +368,9 @@ TEST(distribution, AllNonzero) {
 
 TEST(distribution, SmallAlphaCorrect) {
     std::vector<category_counts_t> data = {{0, 0, 5}};
-    std::default_random_engine generator;
     Options options;
     options.exact = true;
-    ModelDistribution model_distribution(data, generator, options);
+    ModelDistribution model_distribution(data, options);
 
     alpha_t alpha = {false, false, true};
     std::vector<alpha_t> alphas = {alpha};
@@ -257,10 +382,9 @@ TEST(distribution, SmallAlphaCorrect) {
 
 TEST(distribution, SmallAlphaWrong) {
     std::vector<category_counts_t> data = {{0, 0, 5}};
-    std::default_random_engine generator;
     Options options;
     options.exact = true;
-    ModelDistribution model_distribution(data, generator, options);
+    ModelDistribution model_distribution(data, options);
 
     alpha_t alpha = {true, true, true};
     std::vector<alpha_t> alphas = {alpha};
@@ -272,10 +396,9 @@ TEST(distribution, SmallAlphaWrong) {
 
 TEST(distribution, BigAlphaCorrect) {
     std::vector<category_counts_t> data = {{0, 0, 10}};
-    std::default_random_engine generator;
     Options options;
     options.exact = true;
-    ModelDistribution model_distribution(data, generator, options);
+    ModelDistribution model_distribution(data, options);
 
     alpha_t alpha = {false, false, true};
     std::vector<alpha_t> alphas = {alpha};
@@ -287,10 +410,9 @@ TEST(distribution, BigAlphaCorrect) {
 
 TEST(distribution, BigAlphaWrong) {
     std::vector<category_counts_t> data = {{0, 0, 10}};
-    std::default_random_engine generator;
     Options options;
     options.exact = true;
-    ModelDistribution model_distribution(data, generator, options);
+    ModelDistribution model_distribution(data, options);
 
     alpha_t alpha = {true, true, true};
     std::vector<alpha_t> alphas = {alpha};
@@ -300,4 +422,131 @@ TEST(distribution, BigAlphaWrong) {
     ASSERT_NEAR(std::exp(result), 621377.0 / 1330255872.0, ERROR);
 }
 
+TEST(distribution, DuplicateObjectsMatchUnique) {
+    std::vector<category_counts_t> data = {{0, 0, 5}, {2, 2, 2}, {0, 0, 5}, {0, 0, 5}};
+    Options options;
+    options.exact = true;
+    ModelDistribution model_distribution(data, options);
+
+    std::vector<std::vector<alpha_t>> alphas_per_object = {
+        {{false, false, true}, {true, true, true}},
+        {{true, true, true}},
+        {{true, true, true}},
+        {{false, false, true}}};
+    double epsilon = 0.5;
+    delta_t delta = {1.0 / 3.0, 1.0 / 3.0, 1.0 / 3.0};
+    std::vector<std::vector<double>> result =
+        model_distribution.distribution(alphas_per_object, epsilon, delta);
+
+    ASSERT_EQ(result.size(), 4);
+    ASSERT_EQ(result.at(0).size(), 2);
+    ASSERT_NEAR(std::exp(result.at(0).at(0)), 32.0 / 243.0, ERROR);
+    ASSERT_NEAR(std::exp(result.at(0).at(1)), 101.0 / 9072.0, ERROR);
+    ASSERT_EQ(result.at(2).at(0), result.at(0).at(1));
+    ASSERT_EQ(result.at(3).at(0), result.at(0).at(0));
+}
+
+TEST(distribution, ThreadedMatchesSerial) {
+    std::vector<category_counts_t> data = {{0, 0, 5}, {2, 2, 2}, {3, 1, 4}, {0, 0, 5}, {7, 0, 2}};
+    std::vector<alpha_t> alphas = {{true, true, true}, {false, false, true}, {true, false, true}};
+    double epsilon = 0.3;
+    delta_t delta = {0.2, 0.5, 0.3};
+
+    Options options;
+    options.exact = true;
+    ModelDistribution serial(data, options);
+    options.threads = 4;
+    ModelDistribution threaded(data, options);
+
+    ASSERT_EQ(threaded.distribution(alphas, epsilon, delta),
+              serial.distribution(alphas, epsilon, delta));
+}
+
+TEST(distribution, TruncationMatchesFullSum) {
+    std::vector<category_counts_t> data = {{30, 20, 250}, {2, 2, 2}};
+    std::vector<alpha_t> alphas = {{false, false, true}, {false, true, true}};
+    double epsilon = 0.2;
+    delta_t delta = {0.2, 0.3, 0.5};
+
+    Options options;
+    options.exact = true;
+    ModelDistribution full(data, options);
+    options.exact = false;
+    options.approx_tolerance = 0;
+    options.truncation_tolerance = 1e-10;
+    ModelDistribution truncated(data, options);
+
+    std::vector<std::vector<double>> expected = full.distribution(alphas, epsilon, delta);
+    std::vector<std::vector<double>> result = truncated.distribution(alphas, epsilon, delta);
+    for (int i = 0; i < data.size(); ++i) {
+        for (int j = 0; j < alphas.size(); ++j) {
+            ASSERT_NEAR(result.at(i).at(j), expected.at(i).at(j), 1e-9);
+        }
+    }
+    ASSERT_EQ(full.get_skipped_terms(), 0);
+    ASSERT_GT(full.get_evaluated_terms(), 0);
+    ASSERT_GT(truncated.get_skipped_terms(), truncated.get_evaluated_terms());
+}
+
+TEST(distribution, ComparisonReportsAndKeepsExactValues) {
+    std::vector<category_counts_t> data = {{2, 2, 2}, {3, 1, 4}, {7, 0, 2}};
+    std::vector<alpha_t> alphas = {{true, true, true}, {true, false, true}};
+    double epsilon = 0.3;
+    delta_t delta = {0.2, 0.5, 0.3};
+
+    Options options;
+    options.approx_tolerance = 0;
+    ModelDistribution plain(data, options);
+    ASSERT_EQ(plain.get_comparison_report(), nullptr);
+    options.comparison = true;
+    options.comparison_fraction = 0.5;
+    ModelDistribution comparing(data, options);
+
+    ASSERT_EQ(comparing.distribution(alphas, epsilon, delta),
+              plain.distribution(alphas, epsilon, delta));
+    ASSERT_GT(comparing.get_comparison_report()->size(), 0);
+}
+
+TEST(calculate_normal_approximation, SeededMvi3) {
+    delta_t delta = {0.1, 0.2, 0.3, 0.4};
+    category_counts_t object_counts = {30, 40, 20, 50};
+    alpha_t alpha = {true, true, true, true};
+    NormalApproximation first =
+        ModelDistribution::calculate_normal_approximation(80, alpha, delta, object_counts, 5);
+    // Another object's problem in between doesn't move this one's stream.
+    ModelDistribution::calculate_normal_approximation(80, alpha, delta, {31, 40, 20, 50}, 5);
+    NormalApproximation same =
+        ModelDistribution::calculate_normal_approximation(80, alpha, delta, object_counts, 5);
+    NormalApproximation other =
+        ModelDistribution::calculate_normal_approximation(80, alpha, delta, object_counts, 6);
+
+    ASSERT_EQ(first.dimensions, 3);
+    ASSERT_EQ(first.probability, same.probability);
+    ASSERT_NE(first.probability, other.probability);
+    // MVI3 runs with few samples, so estimates are coarse.
+    ASSERT_NEAR(first.probability, other.probability, 0.1);
+}
+
+TEST(distribution, DispatchModelFromOptions) {
+    std::vector<category_counts_t> data = {{200, 150, 300}, {120, 80, 90}};
+    std::vector<alpha_t> alphas = {{true, true, true}, {true, false, true}};
+    Options exact_options;
+    exact_options.exact = true;
+    Options free_exact_options;
+    // Exact evaluation costs nothing, so it is always chosen.
+    free_exact_options.dispatch_model.exact_ns_per_point = 0;
+    Options approximate_options;
+    // Approximation is free and trusted, so it is used wherever it applies.
+    approximate_options.dispatch_model.closed_form_ns = 0;
+    approximate_options.dispatch_model.error_constant = 0;
+
+    ModelDistribution exact(data, exact_options);
+    ModelDistribution free_exact(data, free_exact_options);
+    ModelDistribution approximate(data, approximate_options);
+    ASSERT_EQ(free_exact.distribution(alphas, 0.3, {0.2, 0.5, 0.3}),
+              exact.distribution(alphas, 0.3, {0.2, 0.5, 0.3}));
+    ASSERT_NE(approximate.distribution(alphas, 0.3, {0.2, 0.5, 0.3}),
+              exact.distribution(alphas, 0.3, {0.2, 0.5, 0.3}));
+}
+
 }  // namespace FilterModel
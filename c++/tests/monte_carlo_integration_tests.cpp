@@ -1,6 +1,8 @@
 #include <boost/log/core.hpp>
 #include <boost/log/expressions.hpp>
 #include <boost/log/trivial.hpp>
+#include <cmath>
+#include <random>
 #include <vector>
 #include "../model_distribution.hpp"
 #include "../monte_carlo_integration.hpp"
@@ -55,11 +57,122 @@ TEST(integrate, IntegrationCloseToExact) {
         n_positive, n_negative, alpha, delta, object_counts);
 
     // Approx
-    ModelDistribution model_distribution({}, generator, false);
-    double sum_over_k_negative_approx = model_distribution.calculate_sum_over_k_negative_approx_2(
-        n_positive, n_negative, alpha, delta, object_counts);
+    double sum_over_k_negative_approx = ModelDistribution::calculate_sum_over_k_negative_approx_2(
+        n_positive, n_negative, alpha, delta, object_counts, generator);
 
     ASSERT_NEAR(sum_over_k_negative_approx, sum_over_k_negative_exact, 0.01);
 }
 
-}  // namespace FilterModel
\ No newline at end of file
+TEST(integrate_qmc, XYOverUnitSquare) {
+    std::default_random_engine generator;
+    auto sampler = [](const std::vector<double> &u, std::vector<double> &point) { point = u; };
+    auto f = [](const std::vector<double> &point) { return point[0] * point[1]; };
+
+    IntegrationOptions options;
+    options.relative_tolerance = 1e-5;
+    options.max_points = 1 << 20;
+    IntegrationEstimate estimate = integrate_qmc(f, sampler, 2, 1.0, generator, options);
+
+    ASSERT_NEAR(estimate.value, 1.0 / 4.0, 5 * estimate.standard_error);
+    ASSERT_LE(estimate.standard_error, 1e-5 / 4.0);
+    // Far fewer points than plain Monte Carlo would need for the same error.
+    ASSERT_LT(estimate.n_points, 1 << 20);
+}
+
+TEST(integrate_qmc, StopsAtMaxPoints) {
+    std::default_random_engine generator;
+    auto sampler = [](const std::vector<double> &u, std::vector<double> &point) { point = u; };
+    // Discontinuous, so the error shrinks slowly.
+    auto f = [](const std::vector<double> &point) {
+        return point[0] * point[0] + point[1] * point[1] <= 1 ? 1.0 : 0.0;
+    };
+
+    IntegrationOptions options;
+    options.absolute_tolerance = 1e-12;
+    options.relative_tolerance = 0;
+    options.max_points = 4096;
+    IntegrationEstimate estimate = integrate_qmc(f, sampler, 2, 4.0, generator, options);
+
+    ASSERT_EQ(estimate.n_points, 4096);
+    ASSERT_NEAR(estimate.value, M_PI, 5 * estimate.standard_error);
+}
+
+TEST(integrate_qmc, SameResultWithThreads) {
+    auto sampler = [](const std::vector<double> &u, std::vector<double> &point) {
+        for (int i = 0; i < u.size(); ++i) {
+            point[i] = 2 * u[i] - 1;
+        }
+    };
+    auto f = [](const std::vector<double> &point) {
+        return std::exp(-(point[0] * point[0] + point[1] * point[1] + point[2] * point[2]));
+    };
+
+    IntegrationOptions options;
+    options.relative_tolerance = 0;
+    options.max_points = 1 << 14;
+
+    std::default_random_engine serial_generator(3);
+    IntegrationEstimate serial = integrate_qmc(f, sampler, 3, 8.0, serial_generator, options);
+
+    ThreadPool thread_pool(4);
+    std::default_random_engine parallel_generator(3);
+    IntegrationEstimate parallel =
+        integrate_qmc(f, sampler, 3, 8.0, parallel_generator, options, &thread_pool);
+
+    ASSERT_EQ(serial.value, parallel.value);
+    ASSERT_EQ(serial.standard_error, parallel.standard_error);
+    double exact = std::pow(std::sqrt(M_PI) * std::erf(1.0), 3);
+    ASSERT_NEAR(serial.value, exact, 5 * serial.standard_error);
+}
+
+TEST(importance_sample, ConstantWeights) {
+    std::default_random_engine generator;
+    auto block_weights = [](std::default_random_engine &generator, int n_points,
+                            std::vector<double> &weights) {
+        std::fill(weights.begin(), weights.begin() + n_points, 2.0);
+    };
+
+    IntegrationOptions options;
+    ImportanceEstimate estimate = importance_sample(block_weights, generator, options);
+
+    ASSERT_DOUBLE_EQ(estimate.value, 2.0);
+    ASSERT_NEAR(estimate.standard_error, 0.0, 1e-12);
+    ASSERT_EQ(estimate.n_points, options.min_points);
+    ASSERT_DOUBLE_EQ(estimate.effective_sample_size, options.min_points);
+}
+
+TEST(calculate_sum_over_k_negative_importance, CloseToExact) {
+    std::default_random_engine generator;
+    alpha_t alpha({true, true, true});
+    category_counts_t object_counts({100, 100, 100});
+    delta_t delta({1.0 / 3.0, 1.0 / 2.0, 1.0 / 6.0});
+
+    double exact = ModelDistribution::calculate_sum_over_k_negative_exact(200, 100, alpha, delta,
+                                                                          object_counts);
+    ImportanceEstimate estimate = ModelDistribution::calculate_sum_over_k_negative_importance(
+        100, alpha, delta, object_counts, generator);
+
+    ASSERT_NEAR(estimate.value, exact, 0.01);
+    ASSERT_LE(estimate.standard_error, 2e-3 * estimate.value);
+    ASSERT_GT(estimate.effective_sample_size, estimate.n_points / 2);
+}
+
+TEST(calculate_sum_over_k_negative_importance, MassInACorner) {
+    // The guassian's mass is near k_1^- = k_2^- = 0, a corner of the slice, where uniform
+    // sampling puts few points.
+    alpha_t alpha({true, true, true});
+    category_counts_t object_counts({200, 200, 60});
+    delta_t delta({0.05, 0.05, 0.9});
+
+    std::default_random_engine generator;
+    double uniform = ModelDistribution::calculate_sum_over_k_negative_approx_2(
+        400, 60, alpha, delta, object_counts, generator);
+    ImportanceEstimate estimate = ModelDistribution::calculate_sum_over_k_negative_importance(
+        60, alpha, delta, object_counts, generator);
+
+    ASSERT_NEAR(estimate.value, uniform, 0.01 * uniform);
+    ASSERT_LE(estimate.standard_error, 2e-3 * estimate.value);
+    ASSERT_GT(estimate.effective_sample_size, estimate.n_points / 2);
+}
+
+}  // namespace FilterModel
@@ -1,6 +1,8 @@
 #include "../multinomial.hpp"
+#include "../multinomial_batch.hpp"
 
 #include <cmath>
+#include <vector>
 
 #include "gtest/gtest.h"
 
@@ -70,4 +72,92 @@ TEST(log_pdf, CrashesWithBadK) {
 }
 
 TEST(fix_dimensions, UntestedBecauseCurrentlyDeadCode) {}
+
+TEST(log_sum_row, MatchesLogPdf) {
+    int n = 700;
+    Multinomial m(n, {0.25, 0.6, 0.15});
+    int k_1 = 180;
+
+    double sum = 0.0;
+    for (int k_2 = 3; k_2 <= 511; ++k_2) {
+        sum += std::exp(m.log_pdf({k_1, k_2, n - k_1 - k_2}));
+    }
+
+    ASSERT_NEAR(MultinomialBatch::log_sum_row(m, k_1, 3, 511), std::log(sum), 1e-10);
+}
+
+TEST(log_sum_row, EmptyRow) {
+    Multinomial m(10, {0.25, 0.6, 0.15});
+    ASSERT_EQ(MultinomialBatch::log_sum_row(m, 2, 5, 4), -INFINITY);
+}
+
+TEST(log_sum_row, SimdMatchesScalar) {
+    std::vector<MultinomialBatch::InstructionSet> instruction_sets = {
+        MultinomialBatch::InstructionSet::SCALAR};
+    if (MultinomialBatch::detected_instruction_set() !=
+        MultinomialBatch::InstructionSet::SCALAR) {
+        instruction_sets.push_back(MultinomialBatch::InstructionSet::AVX2);
+    }
+    if (MultinomialBatch::detected_instruction_set() ==
+        MultinomialBatch::InstructionSet::AVX512) {
+        instruction_sets.push_back(MultinomialBatch::InstructionSet::AVX512);
+    }
+
+    int n = 5000;
+    Multinomial m(n, {0.1, 0.3, 0.6});
+    for (int k_1 : {0, 17, 500, 4990}) {
+        for (int k_2_end : {0, 3, 9, 400, n - k_1}) {
+            double scalar = MultinomialBatch::log_sum_row(
+                m, k_1, 0, k_2_end, MultinomialBatch::InstructionSet::SCALAR);
+            for (MultinomialBatch::InstructionSet instruction_set : instruction_sets) {
+                double simd = MultinomialBatch::log_sum_row(m, k_1, 0, k_2_end, instruction_set);
+                ASSERT_NEAR(simd, scalar, 1e-12 * std::abs(scalar));
+            }
+        }
+    }
+}
+
+TEST(walk_sum, MatchesProducts) {
+    double a = 40, b = 11, ratio = 0.7;
+    double sum = 0.0;
+    double term = 1.0;
+    for (int j = 0; j < 30; ++j) {
+        term *= (a - j) / (b + j) * ratio;
+        sum += term;
+    }
+    for (MultinomialBatch::InstructionSet instruction_set :
+         {MultinomialBatch::InstructionSet::SCALAR, MultinomialBatch::detected_instruction_set()}) {
+        ASSERT_NEAR(MultinomialBatch::walk_sum(a, b, ratio, 30, instruction_set), sum, 1e-12 * sum);
+    }
+    ASSERT_EQ(MultinomialBatch::walk_sum(a, b, ratio, 0), 0.0);
+}
+
+TEST(walk_sum, SimdMatchesScalar) {
+    MultinomialBatch::InstructionSet instruction_set = MultinomialBatch::detected_instruction_set();
+
+    // Walks up from the mode of a binomial row, of lengths around where the vector path starts
+    // and its tail, up to the whole row.
+    int row_n = 5000;
+    for (double ratio : {0.1 / 0.6, 0.6 / 0.1, 1.0}) {
+        int anchor = int((row_n + 1) * ratio / (1 + ratio));
+        for (int count : {1, 15, 16, 17, 19, 20, 21, 400, row_n - anchor}) {
+            double scalar = MultinomialBatch::walk_sum(row_n - anchor, anchor + 1, ratio, count,
+                                                       MultinomialBatch::InstructionSet::SCALAR);
+            double simd = MultinomialBatch::walk_sum(row_n - anchor, anchor + 1, ratio, count,
+                                                     instruction_set);
+            ASSERT_NEAR(simd, scalar, 1e-12 * scalar);
+        }
+    }
+}
+
+TEST(log_sum_exp, SimdMatchesScalar) {
+    std::vector<double> log_terms;
+    for (int i = 0; i < 1003; ++i) {
+        log_terms.push_back(-0.37 * i + std::sin(i) * 50.0);
+    }
+    double scalar = MultinomialBatch::log_sum_exp(log_terms.data(), log_terms.size(),
+                                                  MultinomialBatch::InstructionSet::SCALAR);
+    double simd = MultinomialBatch::log_sum_exp(log_terms.data(), log_terms.size());
+    ASSERT_NEAR(simd, scalar, 1e-12 * std::abs(scalar));
+}
 }  // namespace FilterModel
\ No newline at end of file
@@ -25,4 +25,33 @@ TEST(density, TwoDimensionalAtZeroCorrect) {
     ASSERT_NEAR(normal.density({0.0, 0.0}), std::exp(0) / (2.0 * M_PI), ERROR);
 }
 
+TEST(density, TwoDimensionalCorrelatedCorrect) {
+    MultivariateGuassian normal({1, -1}, {{2}, {0.5, 1}});
+    // The covariance has determinant 1.75 and inverse {{1, -0.5}, {-0.5, 2}} / 1.75.
+    double x = 0.5;
+    double y = 0.0;
+    double quadratic = (x - 1) * (x - 1) - (x - 1) * (y + 1) + 2 * (y + 1) * (y + 1);
+    ASSERT_NEAR(normal.density({x, y}),
+                std::exp(-quadratic / 1.75 / 2.0) / (2.0 * M_PI * std::sqrt(1.75)), 1e-12);
+}
+
+TEST(log_density, MatchesDensity) {
+    MultivariateGuassian normal = MultivariateGuassian::from_multinomial(40, {0.2, 0.3, 0.1});
+    std::vector<double> point = {7.5, 13.0, 2.0};
+    ASSERT_NEAR(normal.log_density(point), std::log(normal.density(point)), 1e-12);
+}
+
+TEST(log_density_batch, MatchesLogDensity) {
+    MultivariateGuassian normal = MultivariateGuassian::from_multinomial(40, {0.2, 0.3, 0.1});
+    Eigen::MatrixXd points(3, 4);
+    points << 8, 7.5, 0, 12, 12, 13, 0, 20, 4, 2, 0, 1;
+
+    Eigen::VectorXd log_densities = normal.log_density_batch(points);
+    ASSERT_EQ(log_densities.size(), 4);
+    for (int j = 0; j < points.cols(); ++j) {
+        std::vector<double> point = {points(0, j), points(1, j), points(2, j)};
+        ASSERT_NEAR(log_densities[j], normal.log_density(point), 1e-12);
+    }
+}
+
 }  // namespace FilterModel
\ No newline at end of file
@@ -4,6 +4,8 @@
 #include "../utils.hpp"
 #include "gtest/gtest.h"
 
+#include <cmath>
+#include <thread>
 #include <vector>
 
 // Not sure why but these examples only match to a very small accuracy.
@@ -62,6 +64,69 @@ TEST(Integrate, Example3) {
     ASSERT_NEAR(mvi3.integrate(457, 30, 100, 100, covariance, hyperplanes), 5.003167E-01, 0.01);
 }
 
+// The values below are the output of the original Fortran program for the same input.
+TEST(Estimate, MatchesFortranProgram) {
+    Mvi3 mvi3;
+    std::vector<std::vector<double>> covariance = {{1}, {.5, 1}, {.5, .5, 1}, {.5, .5, .5, 1}};
+    std::vector<std::vector<double>> hyperplanes = {{2, -1, 0, 0, 1},
+                                                    {1, 0, -1, 0, 1},
+                                                    {0, 0, -1, 1, 1},
+                                                    {-1, -1, 2, 0, 1},
+                                                    {-1, -1, -4, 0, 1}};
+
+    Estimate estimate = mvi3.estimate(457, -1, 100, 100, covariance, hyperplanes);
+    ASSERT_NEAR(estimate.value, 0.181171775, 1e-7);
+    ASSERT_NEAR(estimate.standard_error, 1.82816305E-03, 1e-9);
+}
+
+TEST(Estimate, SingleRepetitionHasNoError) {
+    Mvi3 mvi3;
+    std::vector<std::vector<double>> covariance = {{1}, {0, 1}, {0, 0, 1}};
+    std::vector<std::vector<double>> hyperplanes = {
+        {-1, 0, 0, 1}, {1, 0, 0, 2}, {0, -1, 0, 2.1}, {0, 1, 0, 1.4}, {0, 0, -1, 0.5}};
+
+    Estimate estimate = mvi3.estimate(457, -1, 10000, 1, covariance, hyperplanes);
+    ASSERT_NEAR(estimate.value, 0.509160817, 1e-7);
+    ASSERT_TRUE(std::isnan(estimate.standard_error));
+}
+
+TEST(Estimate, CrudeWhenOriginOutside) {
+    Mvi3 mvi3;
+    std::vector<std::vector<double>> covariance = {{1}, {0, 1}, {0, 0, 1}};
+    // x_1 >= 0.5 excludes the origin.
+    std::vector<std::vector<double>> hyperplanes = {
+        {1, 0, 0, -0.5}, {-1, 0, 0, 2}, {0, 1, 0, 1}, {0, 0, 1, 1}};
+
+    Estimate known_variance = mvi3.estimate(457, -1, 500, 3, covariance, hyperplanes);
+    ASSERT_NEAR(known_variance.value, 0.206666663, 1e-7);
+    ASSERT_NEAR(known_variance.standard_error, 7.39268912E-03, 1e-9);
+
+    Estimate estimated_variance = mvi3.estimate(99, 12, 500, 3, covariance, hyperplanes);
+    ASSERT_NEAR(estimated_variance.value, 0.196333334, 1e-7);
+    ASSERT_NEAR(estimated_variance.standard_error, 7.25227641E-03, 1e-9);
+}
+
+TEST(Estimate, SameSeedSameResultAcrossThreads) {
+    std::vector<std::vector<double>> covariance = {{1}, {0, 1}, {0, 0, 1}};
+    std::vector<std::vector<double>> hyperplanes = {
+        {-1, 0, 0, 1}, {1, 0, 0, 2}, {0, -1, 0, 2.1}, {0, 1, 0, 1.4}, {0, 0, -1, 0.5}};
+
+    std::vector<double> results(4);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < results.size(); ++i) {
+        threads.push_back(std::thread([&results, &covariance, &hyperplanes, i]() {
+            results.at(i) = Mvi3().integrate(457, 30, 1000, 10, covariance, hyperplanes);
+        }));
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    for (double result : results) {
+        ASSERT_EQ(result, results.front());
+    }
+    ASSERT_NEAR(results.front(), 5.003167E-01, 1e-7);
+}
+
 // TODO(joschnei): This test currently only works for all alpha = 1. When this issue is fixed,
 // tests for some alpha != 1 should be written.
 TEST(Integrate, IntegrationCloseToExact1) {
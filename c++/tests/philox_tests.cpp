@@ -0,0 +1,52 @@
+#include "../philox.hpp"
+#include "gtest/gtest.h"
+
+#include <random>
+#include <vector>
+
+namespace FilterModel {
+
+// Known answers from the Random123 distribution.
+TEST(Philox4x32, KnownAnswers) {
+    Philox4x32::counter_t zeros = {{0, 0, 0, 0}};
+    Philox4x32::counter_t expected_zeros = {{0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8}};
+    ASSERT_EQ(Philox4x32::block(zeros, {{0, 0}}), expected_zeros);
+
+    Philox4x32::counter_t ones = {{0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}};
+    Philox4x32::counter_t expected_ones = {{0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd}};
+    ASSERT_EQ(Philox4x32::block(ones, {{0xffffffff, 0xffffffff}}), expected_ones);
+
+    Philox4x32::counter_t pi = {{0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344}};
+    Philox4x32::counter_t expected_pi = {{0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1}};
+    ASSERT_EQ(Philox4x32::block(pi, {{0xa4093822, 0x299f31d0}}), expected_pi);
+}
+
+TEST(Philox4x32, StreamsRepeatAndDiffer) {
+    Philox4x32 first(7, 3, 1);
+    Philox4x32 same(7, 3, 1);
+    Philox4x32 other_substream(7, 3, 2);
+    Philox4x32 other_stream(7, 4, 1);
+    std::vector<uint32_t> a, b, c, d;
+    for (int i = 0; i < 10; ++i) {
+        a.push_back(first());
+        b.push_back(same());
+        c.push_back(other_substream());
+        d.push_back(other_stream());
+    }
+    ASSERT_EQ(a, b);
+    ASSERT_NE(a, c);
+    ASSERT_NE(a, d);
+}
+
+TEST(Philox4x32, UniformMean) {
+    Philox4x32 generator(11, 0);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    double mean = 0.0;
+    const int n = 100000;
+    for (int i = 0; i < n; ++i) {
+        mean += uniform(generator) / n;
+    }
+    ASSERT_NEAR(mean, 0.5, 0.005);
+}
+
+}  // namespace FilterModel
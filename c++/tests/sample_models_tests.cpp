@@ -23,4 +23,47 @@ TEST(generate_all_alphas, Three) {
                                             {1, 0, 1}, {0, 1, 1}, {1, 1, 1}};
     ASSERT_EQ(alphas, expected_alphas);
 }
-}  // namespace FilterModel
\ No newline at end of file
+
+TEST(ModelSampler, LogLikelyhoodsOfSampledAlphas) {
+    std::vector<category_counts_t> data = {{5, 0, 1}, {2, 2, 2}, {0, 7, 1}};
+    Options options;
+    ModelSampler sampler(data, 41, options);
+    delta_t delta = {0.2, 0.3, 0.5};
+    std::vector<double> log_likelyhoods;
+    std::vector<alpha_t> models = sampler.sample(0.3, delta, &log_likelyhoods);
+
+    ASSERT_EQ(log_likelyhoods.size(), data.size());
+    std::vector<std::vector<alpha_t>> alphas_per_object;
+    for (const alpha_t &alpha : models) {
+        alphas_per_object.push_back({alpha});
+    }
+    std::vector<std::vector<double>> expected =
+        sampler.get_model_distribution().distribution(alphas_per_object, 0.3, delta);
+    for (int i = 0; i < data.size(); ++i) {
+        ASSERT_DOUBLE_EQ(log_likelyhoods[i], expected[i][0]);
+    }
+}
+
+TEST(ModelSampler, SameModelsOnAnyNumberOfThreads) {
+    std::vector<category_counts_t> data = {{5, 0, 1}, {2, 2, 2}, {0, 7, 1}, {1, 1, 0},
+                                           {3, 0, 3}, {0, 0, 4}, {6, 1, 1}, {2, 5, 0}};
+    delta_t delta = {0.2, 0.3, 0.5};
+    Options serial_options;
+    Options parallel_options;
+    parallel_options.threads = 4;
+    ModelSampler serial(data, 43, serial_options);
+    ModelSampler parallel(data, 43, parallel_options);
+    ModelSampler other_seed(data, 44, serial_options);
+
+    std::vector<alpha_t> first = serial.sample(0.3, delta);
+    ASSERT_EQ(first, parallel.sample(0.3, delta));
+    ASSERT_EQ(serial.sample(0.3, delta), parallel.sample(0.3, delta));
+    // Each call opens new streams.
+    bool differs = false;
+    for (int i = 0; i < 5; ++i) {
+        differs |= serial.sample(0.3, delta) != first;
+        differs |= other_seed.sample(0.3, delta) != first;
+    }
+    ASSERT_TRUE(differs);
+}
+}  // namespace FilterModel
@@ -0,0 +1,71 @@
+#include "../sobol_sequence.hpp"
+
+#include <cstdint>
+#include <set>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace FilterModel {
+
+std::vector<std::vector<uint32_t>> sobol_points(int dimensions, uint32_t start, uint32_t end) {
+    SobolSequence sequence(dimensions);
+    std::vector<std::vector<uint32_t>> points;
+    std::vector<uint32_t> point(dimensions);
+    sequence.at(start, point.data());
+    for (uint32_t i = start; i < end; ++i) {
+        points.push_back(point);
+        sequence.next(i, point.data());
+    }
+    return points;
+}
+
+TEST(SobolSequence, NextMatchesAt) {
+    SobolSequence sequence(SobolSequence::MAX_DIMENSIONS);
+    std::vector<std::vector<uint32_t>> points =
+        sobol_points(SobolSequence::MAX_DIMENSIONS, 37, 1000);
+    std::vector<uint32_t> point(SobolSequence::MAX_DIMENSIONS);
+    for (uint32_t i = 37; i < 1000; ++i) {
+        sequence.at(i, point.data());
+        ASSERT_EQ(point, points.at(i - 37));
+    }
+}
+
+TEST(SobolSequence, FirstPoints) {
+    // Gray code order visits sobol indices 0, 1, 3, 2.
+    std::vector<std::vector<uint32_t>> points = sobol_points(2, 0, 4);
+    ASSERT_EQ(points.at(0), std::vector<uint32_t>({0, 0}));
+    ASSERT_EQ(points.at(1), std::vector<uint32_t>({1u << 31, 1u << 31}));
+    ASSERT_EQ(points.at(2), std::vector<uint32_t>({3u << 30, 1u << 30}));
+    ASSERT_EQ(points.at(3), std::vector<uint32_t>({1u << 30, 3u << 30}));
+}
+
+TEST(SobolSequence, BlocksStratifyEveryCoordinate) {
+    const int m = 8;
+    for (uint32_t start : {0u, 1u << m, 5u << m}) {
+        std::vector<std::vector<uint32_t>> points =
+            sobol_points(SobolSequence::MAX_DIMENSIONS, start, start + (1u << m));
+        for (int d = 0; d < SobolSequence::MAX_DIMENSIONS; ++d) {
+            std::set<uint32_t> intervals;
+            for (const std::vector<uint32_t> &point : points) {
+                intervals.insert(point[d] >> (SobolSequence::BITS - m));
+            }
+            ASSERT_EQ(intervals.size(), 1u << m) << "dimension " << d;
+        }
+    }
+}
+
+TEST(SobolSequence, FirstTwoDimensionsAreANet) {
+    // Every 2^a by 2^(m - a) box holds exactly one of the first 2^m points.
+    const int m = 6;
+    std::vector<std::vector<uint32_t>> points = sobol_points(2, 0, 1u << m);
+    for (int a = 0; a <= m; ++a) {
+        std::set<std::pair<uint32_t, uint32_t>> boxes;
+        for (const std::vector<uint32_t> &point : points) {
+            boxes.insert({a == 0 ? 0 : point[0] >> (SobolSequence::BITS - a),
+                          a == m ? 0 : point[1] >> (SobolSequence::BITS - (m - a))});
+        }
+        ASSERT_EQ(boxes.size(), 1u << m);
+    }
+}
+}  // namespace FilterModel
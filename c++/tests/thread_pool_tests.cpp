@@ -0,0 +1,37 @@
+#include "../thread_pool.hpp"
+#include "gtest/gtest.h"
+
+#include <vector>
+
+namespace FilterModel {
+
+TEST(parallel_for, VisitsEveryIndexOnce) {
+    ThreadPool pool(4);
+    ASSERT_EQ(pool.size(), 4);
+
+    std::vector<int> visits(1000, 0);
+    for (int repeat = 0; repeat < 10; ++repeat) {
+        pool.parallel_for(visits.size(), [&visits](int i) { visits.at(i) += 1; });
+    }
+
+    ASSERT_EQ(visits, std::vector<int>(1000, 10));
+}
+
+TEST(parallel_for, SingleThreadIsSerial) {
+    ThreadPool pool(1);
+    ASSERT_EQ(pool.size(), 1);
+
+    std::vector<int> order;
+    pool.parallel_for(5, [&order](int i) { order.push_back(i); });
+
+    ASSERT_EQ(order, std::vector<int>({0, 1, 2, 3, 4}));
+}
+
+TEST(parallel_for, Empty) {
+    ThreadPool pool(4);
+    int calls = 0;
+    pool.parallel_for(0, [&calls](int i) { ++calls; });
+    ASSERT_EQ(calls, 0);
+}
+
+}  // namespace FilterModel
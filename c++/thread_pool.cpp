@@ -0,0 +1,79 @@
+#include "thread_pool.hpp"
+
+namespace FilterModel {
+
+ThreadPool::ThreadPool(int n_threads) : next_index(0) {
+    for (int i = 1; i < n_threads; ++i) {
+        workers.push_back(std::thread(&ThreadPool::worker_loop, this));
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    work_available.notify_all();
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::parallel_for(int n, const std::function<void(int)> &f) {
+    if (workers.empty() || n <= 1) {
+        for (int i = 0; i < n; ++i) {
+            f(i);
+        }
+        return;
+    }
+
+    std::lock_guard<std::mutex> job_lock(job_mutex);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    job = &f;
+    job_size = n;
+    next_index.store(0);
+    busy_workers = workers.size();
+    ++generation;
+    lock.unlock();
+    work_available.notify_all();
+
+    // The calling thread works on the job too rather than sitting idle.
+    run_job(f, n);
+
+    lock.lock();
+    job_done.wait(lock, [this] { return busy_workers == 0; });
+    job = nullptr;
+}
+
+void ThreadPool::worker_loop() {
+    long seen_generation = 0;
+    while (true) {
+        std::unique_lock<std::mutex> lock(mutex);
+        work_available.wait(
+            lock, [this, seen_generation] { return stopping || generation != seen_generation; });
+        if (stopping) {
+            return;
+        }
+        seen_generation = generation;
+        const std::function<void(int)> *f = job;
+        int n = job_size;
+        lock.unlock();
+
+        run_job(*f, n);
+
+        lock.lock();
+        if (--busy_workers == 0) {
+            job_done.notify_all();
+        }
+    }
+}
+
+void ThreadPool::run_job(const std::function<void(int)> &f, int n) {
+    int i;
+    while ((i = next_index.fetch_add(1)) < n) {
+        f(i);
+    }
+}
+
+}  // namespace FilterModel
@@ -0,0 +1,70 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+/**
+ * Contains a fixed size pool of worker threads for evaluating independent tasks in parallel.
+ */
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace FilterModel {
+class ThreadPool {
+   public:
+    /**
+     * Creates a pool that runs tasks on n_threads threads in total. The calling thread counts as
+     * one of them, so n_threads - 1 workers are started. n_threads <= 1 runs everything serially
+     * on the calling thread.
+     */
+    explicit ThreadPool(int n_threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    /**
+     * Calls f(i) for every i in [0, n) and returns once every call has finished.
+     *
+     * Indices are handed out one at a time, so tasks of very different cost still balance across
+     * threads. The order the calls run in is unspecified; callers that need deterministic results
+     * should have f(i) only write to its own output slot and reduce afterwards in index order.
+     *
+     * Calls from different threads are serialized. f must not itself call parallel_for on the
+     * same pool.
+     */
+    void parallel_for(int n, const std::function<void(int)> &f);
+
+    /**
+     * Returns the total number of threads tasks run on, including the calling thread.
+     */
+    int size() const { return workers.size() + 1; }
+
+   private:
+    std::vector<std::thread> workers;
+
+    // Serializes parallel_for calls.
+    std::mutex job_mutex;
+
+    // Guards everything below.
+    std::mutex mutex;
+    std::condition_variable work_available;
+    std::condition_variable job_done;
+    bool stopping = false;
+    // Incremented for every job so workers can tell a new job from a spurious wake up.
+    long generation = 0;
+    const std::function<void(int)> *job = nullptr;
+    int job_size = 0;
+    int busy_workers = 0;
+
+    std::atomic<int> next_index;
+
+    void worker_loop();
+    void run_job(const std::function<void(int)> &f, int n);
+};
+}  // namespace FilterModel
+
+#endif
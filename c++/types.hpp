@@ -1,6 +1,10 @@
 #ifndef TYPES_HPP
 #define TYPES_HPP
 
+#include "alpha.hpp"
+
+#include <cstdint>
+#include <string>
 #include <vector>
 
 /**
@@ -22,11 +26,11 @@ typedef std::vector<category_count_t> category_counts_t;
 
 // Boolean value representing if a specific object can be used in some context.
 typedef bool category_t;
-// A vector of category_ts representing the allowable usage context.
+// A bitmask of category_ts representing the allowable usage context.
 // E.g. if the object is 'the' and the categories are 'MASS', 'PLURAL', or 'SINGULAR_OR_MASS' then
 // <1,0,1> means 'the' can be used in the 'MASS' and 'SINGULAR_OR_MASS' contexts, but not the
 // 'PLURAL' context.
-typedef std::vector<category_t> alpha_t;
+typedef Alpha alpha_t;
 // A vector of doubles representing the probability of a given error observation falling into each
 // context.
 // E.g. if the contexts are 'MASS', 'PLURAL', or 'SINGULAR_OR_MASS' then <1/2,1/3,1/6> means that a
@@ -34,11 +38,51 @@ typedef std::vector<category_t> alpha_t;
 // 'PLURAL' noun, and 1/6 odds of being a 'SINGULAR_OR_MASS' noun.
 typedef std::vector<double> delta_t;
 
+/**
+ * Costs and the error constant ApproximationDispatcher decides with. The defaults were measured on
+ * a recent x86-64 desktop; ApproximationDispatcher::calibrate() measures them on the current
+ * machine.
+ */
+struct DispatchModel {
+    double exact_ns_per_point = 6.0;
+    double closed_form_ns = 3e4;
+    double mvi3_ns = 1e5;
+    double error_constant = 0.5;
+};
+
 struct Options {
     bool comparison = false;
+    // Fraction of the sums over k^- compared when comparison is set.
+    double comparison_fraction = 1.0;
+    // Where joint inference writes the comparison report.
+    std::string comparison_report_path;
     bool exact = false;
     bool use_smaller_alphas = false;
     bool record_likelyhood = false;
+    // Largest estimated error in log(sum over k^-) the normal approximation may add.
+    double approx_tolerance = 0.01;
+    // Costs the exact and approximate sums are chosen by. Every ModelDistribution in a run must
+    // share the same model, so calibration happens once up front rather than per instance.
+    DispatchModel dispatch_model;
+    // If positive, each object's sum over n^+ starts at the binomial mode and stops once the terms
+    // left are provably at most this fraction of the sum so far. Otherwise every term is evaluated.
+    double truncation_tolerance = 0;
+    // Number of threads to evaluate the likelyhood on.
+    int threads = 1;
+    // Gibbs iterations during which the epsilon and delta proposal scales adapt toward a target
+    // acceptance rate. They are fixed at 0.25 if 0.
+    int adapt_iterations = 0;
+    // Candidates each Metropolis-Hastings step for epsilon and delta tries, evaluated in parallel.
+    int tries = 1;
+    // Number of independent Gibbs chains, each on its own thread.
+    int chains = 1;
+    // If positive, stop sampling once every split R-hat is at most stop_r_hat and every effective
+    // sample size at least stop_ess.
+    double stop_r_hat = 0;
+    double stop_ess = 0;
+    // Every random number in a run is derived from this, so the same seed and options replay the
+    // run exactly, whatever the number of threads.
+    uint64_t seed = 0;
 
     std::vector<alpha_t> fixed_alphas;
 };
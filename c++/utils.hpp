@@ -215,13 +215,14 @@ std::string vector_to_string(std::vector<T> v) {
 }
 
 /**
- * Convers a vector of vectors to a string of nested square brackets and comma separators.
+ * Convers a vector of vectors (or of anything else vector_to_string accepts, such as alphas) to a
+ * string of nested square brackets and comma separators.
  */
-template <class T>
-std::string vector_of_vector_to_string(std::vector<std::vector<T>> vv) {
+template <class V>
+std::string vector_of_vector_to_string(const std::vector<V> &vv) {
     std::string out = "[";
     bool first_vector = true;
-    for (std::vector<T> v : vv) {
+    for (const V &v : vv) {
         if (first_vector) {
             out += vector_to_string(v);
             first_vector = false;
@@ -244,6 +245,17 @@ inline std::vector<T> exp(const std::vector<T> &numbers) {
     return out;
 }
 
+/**
+ * Takes the log of the values of a given vector.
+ */
+template <class T>
+inline std::vector<T> log(const std::vector<T> &numbers) {
+    std::vector<T> out(numbers.size());
+    std::transform(numbers.begin(), numbers.end(), out.begin(),
+                   [](T x) -> T { return std::log(x); });
+    return out;
+}
+
 template <class T>
 inline std::vector<T> flatten(const std::vector<std::vector<T>> &vv) {
     std::vector<double> out(vv.size());